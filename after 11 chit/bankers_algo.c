@@ -2,6 +2,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Matrices are single row-major blocks, each row padded with zeros to a
+// multiple of 16 ints (one cache line) so the row operations below work
+// on whole vectors. Element (i, j) lives at a[i * stride + j].
+#define VEC_INTS 16
+
+int *matrix_alloc(int rows, int stride) {
+    size_t bytes = (size_t) rows * stride * sizeof(int);
+    int *a = aligned_alloc(64, bytes);
+    if (a) memset(a, 0, bytes);
+    return a;
+}
+
+// need <= work in every column?
+bool row_fits(const int *need, const int *work, int stride) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i gt = _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i *)(need + j)),
+                                        _mm256_load_si256((const __m256i *)(work + j)));
+        if (!_mm256_testz_si256(gt, gt)) return false;
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i gt = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)(need + j)),
+                                     _mm_load_si128((const __m128i *)(work + j)));
+        if (_mm_movemask_epi8(gt)) return false;
+    }
+#else
+    for (int j = 0; j < stride; ++j)
+        if (need[j] > work[j]) return false;
+#endif
+    return true;
+}
+
+// work += alloc
+void row_add(int *work, const int *alloc, int stride) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i w = _mm256_load_si256((const __m256i *)(work + j));
+        __m256i a = _mm256_load_si256((const __m256i *)(alloc + j));
+        _mm256_store_si256((__m256i *)(work + j), _mm256_add_epi32(w, a));
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i w = _mm_load_si128((const __m128i *)(work + j));
+        __m128i a = _mm_load_si128((const __m128i *)(alloc + j));
+        _mm_store_si128((__m128i *)(work + j), _mm_add_epi32(w, a));
+    }
+#else
+    for (int j = 0; j < stride; ++j) work[j] += alloc[j];
+#endif
+}
 
 int main() {
     int n, m;
@@ -11,25 +67,23 @@ int main() {
     if (scanf("%d", &m) != 1 || m <= 0) return 1;
 
     // allocate matrices/vectors
-    int **alloc = malloc(n * sizeof(int*));
-    int **max = malloc(n * sizeof(int*));
-    int **need = malloc(n * sizeof(int*));
-    for (int i = 0; i < n; ++i) {
-        alloc[i] = malloc(m * sizeof(int));
-        max[i]   = malloc(m * sizeof(int));
-        need[i]  = malloc(m * sizeof(int));
-    }
-    int *available = malloc(m * sizeof(int));
+    int stride = (m + VEC_INTS - 1) / VEC_INTS * VEC_INTS;
+    int *alloc = matrix_alloc(n, stride);
+    int *max = matrix_alloc(n, stride);
+    int *need = matrix_alloc(n, stride);
+    int *available = matrix_alloc(1, stride);
+    int *work = matrix_alloc(1, stride);
+    if (!alloc || !max || !need || !available || !work) return 1;
 
     printf("Enter Allocation matrix (n rows, m columns):\n");
     for (int i = 0; i < n; ++i)
         for (int j = 0; j < m; ++j)
-            scanf("%d", &alloc[i][j]);
+            scanf("%d", &alloc[i * stride + j]);
 
     printf("Enter Max matrix (n rows, m columns):\n");
     for (int i = 0; i < n; ++i)
         for (int j = 0; j < m; ++j)
-            scanf("%d", &max[i][j]);
+            scanf("%d", &max[i * stride + j]);
 
     printf("Enter Available vector (%d values):\n", m);
     for (int j = 0; j < m; ++j)
@@ -38,10 +92,9 @@ int main() {
     // compute Need = Max - Allocation
     for (int i = 0; i < n; ++i)
         for (int j = 0; j < m; ++j)
-            need[i][j] = max[i][j] - alloc[i][j];
+            need[i * stride + j] = max[i * stride + j] - alloc[i * stride + j];
 
     // Safety algorithm
-    int *work = malloc(m * sizeof(int));
     bool *finish = malloc(n * sizeof(bool));
     for (int j = 0; j < m; ++j) work[j] = available[j];
     for (int i = 0; i < n; ++i) finish[i] = false;
@@ -54,13 +107,9 @@ int main() {
         progress = false;
         for (int i = 0; i < n; ++i) {
             if (!finish[i]) {
-                bool canAllocate = true;
-                for (int j = 0; j < m; ++j) {
-                    if (need[i][j] > work[j]) { canAllocate = false; break; }
-                }
-                if (canAllocate) {
+                if (row_fits(&need[i * stride], work, stride)) {
                     // pretend to allocate and finish process i
-                    for (int j = 0; j < m; ++j) work[j] += alloc[i][j];
+                    row_add(work, &alloc[i * stride], stride);
                     finish[i] = true;
                     safeSeq[count++] = i;
                     progress = true;
@@ -85,9 +134,6 @@ int main() {
     }
 
     // free memory
-    for (int i = 0; i < n; ++i) {
-        free(alloc[i]); free(max[i]); free(need[i]);
-    }
     free(alloc); free(max); free(need);
     free(available); free(work); free(finish); free(safeSeq);
 
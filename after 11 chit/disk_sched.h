@@ -0,0 +1,708 @@
+/*
+ * disk_sched.h
+ *
+ * Disk scheduling algorithms (SSTF, SCAN, C-LOOK, DEADLINE, BFQ, SATF)
+ * and the disk geometry / access-time model they report against.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "disk_sched.h"
+ *   gcc prog.c -o prog -lm
+ *
+ * Every algorithm takes the request cylinders plus the sector of each
+ * request and prints its path and totals, unless sched.quiet is set.
+ * Set sched.order to collect the service order instead.
+ */
+
+#ifndef DISK_SCHED_H
+#define DISK_SCHED_H
+#include <stdio.h>
+#include <stdlib.h> // For abs() and qsort()
+#include <limits.h> // For INT_MAX
+#include <string.h> // For memcpy() and strcmp()
+#include <math.h>   // For sqrt() and floor()
+
+// Key array used by compare_idx() (qsort() has no user-data argument).
+// Thread-local, like sched below, so several threads can each run an
+// algorithm at the same time.
+_Thread_local const int *sort_key;
+
+// A helper for qsort() that orders request indices by sort_key[]
+int compare_idx(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    if (sort_key[x] != sort_key[y]) return (sort_key[x] < sort_key[y]) ? -1 : 1;
+    return x - y;
+}
+
+// ----------------------------------------------------------------
+// Disk geometry and access-time model
+// ----------------------------------------------------------------
+// Seek time for a move of d cylinders is
+//     settle + sqrt_coef * sqrt(d) + linear_coef * d      (0 when d == 0)
+// The sqrt term covers the accelerate/decelerate phase of short seeks and
+// the linear term the coast phase of long ones. After the seek the head
+// waits for the wanted sector to rotate underneath it, then reads it.
+typedef struct {
+    int cylinders;
+    int rpm;
+    int sectors_per_track;
+    double settle_ms;
+    double sqrt_coef_ms;
+    double linear_coef_ms;
+} disk_geom_t;
+
+// Default drive (200 cylinders, 7200 RPM, 1/8/15 ms seeks); programs
+// may overwrite it or recalibrate with disk_geom_calibrate()
+disk_geom_t disk = {200, 7200, 100, 0.148, 0.836, 0.0153};
+
+double seek_time_ms(const disk_geom_t *g, int distance) {
+    if (distance == 0) return 0.0;
+    return g->settle_ms + g->sqrt_coef_ms * sqrt(distance) + g->linear_coef_ms * distance;
+}
+
+double rev_time_ms(const disk_geom_t *g) {
+    return 60000.0 / g->rpm;
+}
+
+double sector_time_ms(const disk_geom_t *g) {
+    return rev_time_ms(g) / g->sectors_per_track;
+}
+
+// Fit settle/sqrt/linear so the curve passes through the three numbers a
+// drive datasheet gives: track-to-track, average (1/3 stroke) and full
+// stroke seek time.
+void disk_geom_calibrate(disk_geom_t *g, double track_ms, double avg_ms, double full_ms) {
+    double d[3] = {1, g->cylinders / 3.0, g->cylinders - 1};
+    double t[3] = {track_ms, avg_ms, full_ms};
+
+    // Solve [1 sqrt(d) d] * [settle sqrt_coef linear_coef]^T = t (Cramer's rule)
+    double m[3][3];
+    for (int i = 0; i < 3; i++) {
+        m[i][0] = 1.0;
+        m[i][1] = sqrt(d[i]);
+        m[i][2] = d[i];
+    }
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+               - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+               + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    double x[3];
+    for (int c = 0; c < 3; c++) {
+        double k[3][3];
+        memcpy(k, m, sizeof(m));
+        for (int i = 0; i < 3; i++) k[i][c] = t[i];
+        double det_c = k[0][0] * (k[1][1] * k[2][2] - k[1][2] * k[2][1])
+                     - k[0][1] * (k[1][0] * k[2][2] - k[1][2] * k[2][0])
+                     + k[0][2] * (k[1][0] * k[2][1] - k[1][1] * k[2][0]);
+        x[c] = det_c / det;
+    }
+    g->settle_ms = x[0];
+    g->sqrt_coef_ms = x[1];
+    g->linear_coef_ms = x[2];
+}
+
+// ----------------------------------------------------------------
+// Head state shared by every algorithm
+// ----------------------------------------------------------------
+// Each algorithm drives a head_t: head_begin() prints the start of the
+// path, head_service() services request i, head_sweep() moves the head
+// to a cylinder without reading anything (SCAN going to the disk edge)
+// and head_end() prints the totals in cylinders and estimated ms.
+typedef struct {
+    const char *name;
+    const int *requests;  // cylinder of each request
+    const int *sector;    // sector of each request
+    int pos;              // current cylinder
+    long total_seek;      // cylinders travelled
+    double time_ms;       // estimated elapsed time
+    int count;            // requests serviced so far
+} head_t;
+
+// Output control shared by all algorithms. Tools that replay the
+// schedule somewhere else set quiet and point order at an n-entry buffer;
+// the algorithms then fill it with request indices in service order.
+// Merged requests (see merge_requests()) cover a range of cylinders:
+// point end at the last cylinder of each one and the head will enter
+// the range at whichever end is nearer and read through to the other.
+// Each thread has its own.
+_Thread_local struct {
+    int quiet;       // don't print the path and totals
+    int *order;      // if not NULL, receives the service order
+    const int *end;  // if not NULL, request i spans requests[i]..end[i]
+    head_t last;     // totals of the most recent run
+} sched;
+
+// Time to reach cyl and read sector from the head's current state
+// (sector < 0 means seek only)
+double access_time_ms(const head_t *h, int cyl, int sector) {
+    double seek = seek_time_ms(&disk, abs(cyl - h->pos));
+    if (sector < 0) return seek;
+
+    // Sector under the head when the seek completes
+    double sector_ms = sector_time_ms(&disk);
+    // (floor() instead of fmod(): it is much cheaper on 10^7-request runs)
+    double spt = disk.sectors_per_track;
+    double turns = (h->time_ms + seek) / sector_ms / spt;
+    double under = (turns - floor(turns)) * spt;
+    double wait = sector - under;
+    if (wait < 0) wait += spt;
+    return seek + (wait + 1.0) * sector_ms;
+}
+
+void head_begin(head_t *h, const char *name, const int requests[], const int sector[], int head) {
+    h->name = name;
+    h->requests = requests;
+    h->sector = sector;
+    h->pos = head;
+    h->total_seek = 0;
+    h->time_ms = 0.0;
+    h->count = 0;
+    if (!sched.quiet) printf("%s Path: %d", name, head);
+}
+
+void head_sweep(head_t *h, int cyl) {
+    h->time_ms += access_time_ms(h, cyl, -1);
+    h->total_seek += abs(cyl - h->pos);
+    h->pos = cyl;
+    if (!sched.quiet) printf(" -> %d", cyl);
+}
+
+// Cylinders from the head to request i: to the nearer end of its range
+// when it is a merged request, 0 from inside the range
+int head_distance(const head_t *h, int i) {
+    int lo = h->requests[i], hi = sched.end ? sched.end[i] : lo;
+    if (h->pos < lo) return lo - h->pos;
+    if (h->pos > hi) return h->pos - hi;
+    return 0;
+}
+
+void head_service(head_t *h, int i) {
+    int from = h->requests[i], to = sched.end ? sched.end[i] : from;
+    if (h->pos - from > to - h->pos) {
+        // Nearer the top of a merged request: enter there and read down
+        from = to;
+        to = h->requests[i];
+    }
+
+    h->time_ms += access_time_ms(h, from, h->sector[i]);
+    h->total_seek += abs(from - h->pos);
+    h->pos = from;
+    if (!sched.quiet) printf(" -> %d", h->pos);
+    if (to != h->pos) {
+        // Read on through the rest of a merged request
+        h->time_ms += seek_time_ms(&disk, abs(to - h->pos));
+        h->total_seek += abs(to - h->pos);
+        h->pos = to;
+        if (!sched.quiet) printf("-%d", h->pos);
+    }
+    if (sched.order) sched.order[h->count] = i;
+    h->count++;
+}
+
+void head_end(head_t *h) {
+    sched.last = *h;
+    if (sched.quiet) return;
+    printf("\nTotal %s Seek Time: %ld\n", h->name, h->total_seek);
+    printf("Estimated %s Time: %.2f ms\n\n", h->name, h->time_ms);
+}
+
+// ----------------------------------------------------------------
+// 1. SSTF: Shortest Seek Time First
+// ----------------------------------------------------------------
+void sstf(int requests[], int sector[], int n, int head) {
+    int serviced_count = 0;
+    head_t h;
+
+    // We'll use an array to mark which requests are done
+    // 0 = not serviced, 1 = serviced
+    int serviced[n];
+    for (int i = 0; i < n; i++) {
+        serviced[i] = 0;
+    }
+
+    head_begin(&h, "SSTF", requests, sector, head);
+
+    // Loop until all requests are serviced
+    while (serviced_count < n) {
+        int min_distance = INT_MAX;
+        int index = -1;
+
+        // Find the closest un-serviced request
+        for (int i = 0; i < n; i++) {
+            if (serviced[i] == 0) {
+                int distance = head_distance(&h, i);
+                if (distance < min_distance) {
+                    min_distance = distance;
+                    index = i;
+                }
+            }
+        }
+
+        // Service the closest request
+        if (index != -1) {
+            head_service(&h, index);
+            serviced[index] = 1; // Mark as serviced
+            serviced_count++;
+        }
+    }
+    head_end(&h);
+}
+
+// ----------------------------------------------------------------
+// Sorting helpers for SCAN and C-LOOK
+// ----------------------------------------------------------------
+// LSD radix sort of request indices by cylinder, 16 bits per pass.
+// order[] receives the request indices and sorted[] the matching
+// cylinders (both n entries). A pass is skipped when every key has the
+// same digit, so cylinder numbers below 65536 cost a single pass.
+void radix_sort_cylinders(const int requests[], int n, int order[], int sorted[]) {
+    if (n == 0) return;
+    unsigned *key = malloc(n * sizeof(unsigned));
+    unsigned *key_tmp = malloc(n * sizeof(unsigned));
+    int *idx_tmp = malloc(n * sizeof(int));
+    size_t *count = malloc(65536 * sizeof(size_t));
+    unsigned *key_buf = key, *key_tmp_buf = key_tmp;
+    int *idx = order;
+
+    // Flip the sign bit so negative numbers (if any) sort first
+    for (int i = 0; i < n; i++) {
+        key[i] = (unsigned) requests[i] ^ 0x80000000u;
+        order[i] = i;
+    }
+
+    for (int shift = 0; shift < 32; shift += 16) {
+        memset(count, 0, 65536 * sizeof(size_t));
+        for (int i = 0; i < n; i++) count[(key[i] >> shift) & 0xffff]++;
+        if (count[(key[0] >> shift) & 0xffff] == (size_t) n) continue;
+
+        size_t sum = 0;
+        for (int d = 0; d < 65536; d++) {
+            size_t c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+        for (int i = 0; i < n; i++) {
+            size_t dst = count[(key[i] >> shift) & 0xffff]++;
+            key_tmp[dst] = key[i];
+            idx_tmp[dst] = idx[i];
+        }
+
+        unsigned *kt = key; key = key_tmp; key_tmp = kt;
+        int *it = idx; idx = idx_tmp; idx_tmp = it;
+    }
+
+    if (idx != order) memcpy(order, idx, n * sizeof(int));
+    for (int i = 0; i < n; i++) sorted[i] = (int)(key[i] ^ 0x80000000u);
+
+    free(key_buf);
+    free(key_tmp_buf);
+    free(idx == order ? idx_tmp : idx);
+    free(count);
+}
+
+// First position in sorted[0..n) holding a cylinder >= cyl
+int lower_bound(const int sorted[], int n, int cyl) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (sorted[mid] < cyl) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// ----------------------------------------------------------------
+// 2. SCAN (Elevator Algorithm)
+// ----------------------------------------------------------------
+// The requests are sorted once and split at the head position, so each
+// direction is one contiguous slice of the sorted order.
+void scan(int requests[], int sector[], int n, int head, int disk_size, char *direction) {
+    // Sort request indices by cylinder so each one keeps its sector
+    int *order = malloc(n * sizeof(int));
+    int *sorted = malloc(n * sizeof(int));
+    radix_sort_cylinders(requests, n, order, sorted);
+
+    head_t h;
+    head_begin(&h, "SCAN", requests, sector, head);
+
+    if (strcmp(direction, "right") == 0) {
+        int split = lower_bound(sorted, n, head);  // first request >= head
+
+        // --- Move Right (UP) ---
+        // Service all requests from head to the end
+        for (int i = split; i < n; i++) head_service(&h, order[i]);
+
+        // Go to the very end of the disk
+        head_sweep(&h, disk_size);
+
+        // --- Move Left (DOWN) ---
+        // Service remaining requests from the end downwards
+        for (int i = split - 1; i >= 0; i--) head_service(&h, order[i]);
+    } else { // Direction is "left"
+        int split = lower_bound(sorted, n, head + 1);  // first request > head
+
+        // --- Move Left (DOWN) ---
+        // Service all requests from head to the beginning
+        for (int i = split - 1; i >= 0; i--) head_service(&h, order[i]);
+
+        // Go to the very beginning of the disk
+        head_sweep(&h, 0);
+
+        // --- Move Right (UP) ---
+        // Service remaining requests from 0 upwards
+        for (int i = split; i < n; i++) head_service(&h, order[i]);
+    }
+
+    head_end(&h);
+    free(order);
+    free(sorted);
+}
+
+// ----------------------------------------------------------------
+// 3. C-LOOK (Circular-LOOK)
+// ----------------------------------------------------------------
+void clook(int requests[], int sector[], int n, int head, char *direction) {
+    // Sort request indices by cylinder so each one keeps its sector
+    int *order = malloc(n * sizeof(int));
+    int *sorted = malloc(n * sizeof(int));
+    radix_sort_cylinders(requests, n, order, sorted);
+
+    head_t h;
+    head_begin(&h, "C-LOOK", requests, sector, head);
+
+    if (strcmp(direction, "right") == 0) {
+        int split = lower_bound(sorted, n, head);  // first request >= head
+
+        // --- Move Right (UP) ---
+        // Service all requests from head to the *last* request
+        for (int i = split; i < n; i++) head_service(&h, order[i]);
+
+        // --- JUMP, then Move Right (UP) again ---
+        // Jump from the last request (highest) to the first (lowest) and
+        // service the rest from the beginning. The jump itself is seek time!
+        for (int i = 0; i < split; i++) head_service(&h, order[i]);
+    } else { // Direction is "left"
+        int split = lower_bound(sorted, n, head + 1);  // first request > head
+
+        // --- Move Left (DOWN) ---
+        // Service all requests from head to the *first* request
+        for (int i = split - 1; i >= 0; i--) head_service(&h, order[i]);
+
+        // --- JUMP, then Move Left (DOWN) again ---
+        // Jump from the first request (lowest) to the last (highest)
+        for (int i = n - 1; i >= split; i--) head_service(&h, order[i]);
+    }
+
+    head_end(&h);
+    free(order);
+    free(sorted);
+}
+
+// ----------------------------------------------------------------
+// 4. DEADLINE (mq-deadline style)
+// ----------------------------------------------------------------
+// Time is measured in the same units as seek distance: the clock moves
+// one unit per cylinder travelled. A request can only be picked once the
+// clock has reached its arrival time.
+#define READ_EXPIRE     50  // reads should start within this many units
+#define WRITE_EXPIRE   500  // writes may wait much longer
+#define FIFO_BATCH      16  // requests per batch before re-deciding direction
+#define WRITES_STARVED   2  // read batches allowed while writes are waiting
+
+void deadline(int requests[], int sector[], int is_write[], int arrival[], int n, int head) {
+    // Two views of the same queue: sorted by cylinder (for the elevator)
+    // and sorted by arrival (for the FIFO expiry check)
+    int *by_cyl = malloc(n * sizeof(int));
+    int *by_arrival = malloc(n * sizeof(int));
+    int *serviced = calloc(n, sizeof(int));
+    for (int i = 0; i < n; i++) {
+        by_cyl[i] = i;
+        by_arrival[i] = i;
+    }
+    sort_key = requests;
+    qsort(by_cyl, n, sizeof(int), compare_idx);
+    sort_key = arrival;
+    qsort(by_arrival, n, sizeof(int), compare_idx);
+
+    int serviced_count = 0;
+    int clock = 0;
+    int data_dir = 0;   // 0 = reads, 1 = writes
+    int batching = 0;   // requests dispatched in the current batch
+    int starved = 0;    // read batches started while writes were waiting
+    head_t h;
+
+    head_begin(&h, "DEADLINE", requests, sector, head);
+
+    while (serviced_count < n) {
+        int index = -1;
+
+        // Keep going up in sort order while the batch lasts
+        if (batching > 0 && batching < FIFO_BATCH) {
+            for (int k = 0; k < n; k++) {
+                int i = by_cyl[k];
+                if (serviced[i] == 0 && is_write[i] == data_dir &&
+                    arrival[i] <= clock && requests[i] >= h.pos) {
+                    index = i;
+                    break;
+                }
+            }
+        }
+
+        if (index == -1) {
+            // --- Start a new batch ---
+            // Oldest waiting request of each direction
+            int fifo_head[2] = {-1, -1};
+            for (int k = 0; k < n; k++) {
+                int i = by_arrival[k];
+                if (serviced[i] == 0 && arrival[i] <= clock && fifo_head[is_write[i]] == -1) {
+                    fifo_head[is_write[i]] = i;
+                }
+            }
+
+            if (fifo_head[0] == -1 && fifo_head[1] == -1) {
+                // Queue is empty: idle until the next request arrives
+                for (int k = 0; k < n; k++) {
+                    if (serviced[by_arrival[k]] == 0) {
+                        clock = arrival[by_arrival[k]];
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            // Reads win unless writes have been starved long enough
+            if (fifo_head[0] != -1 && (fifo_head[1] == -1 || starved < WRITES_STARVED)) {
+                data_dir = 0;
+                if (fifo_head[1] != -1) starved++;
+            } else {
+                data_dir = 1;
+                starved = 0;
+            }
+
+            int expire = data_dir ? WRITE_EXPIRE : READ_EXPIRE;
+            if (arrival[fifo_head[data_dir]] + expire <= clock) {
+                // Deadline passed: serve the oldest request first
+                index = fifo_head[data_dir];
+            } else {
+                // Otherwise continue the sweep from the head, wrapping to
+                // the lowest cylinder when nothing is left above it
+                int lowest = -1;
+                for (int k = 0; k < n; k++) {
+                    int i = by_cyl[k];
+                    if (serviced[i] != 0 || is_write[i] != data_dir || arrival[i] > clock) continue;
+                    if (lowest == -1) lowest = i;
+                    if (requests[i] >= h.pos) {
+                        index = i;
+                        break;
+                    }
+                }
+                if (index == -1) index = lowest;
+            }
+            batching = 0;
+        }
+
+        // Service the chosen request
+        clock += abs(h.pos - requests[index]);
+        head_service(&h, index);
+        serviced[index] = 1;
+        serviced_count++;
+        batching++;
+    }
+    head_end(&h);
+
+    free(by_cyl);
+    free(by_arrival);
+    free(serviced);
+}
+
+// ----------------------------------------------------------------
+// 5. BFQ (Budget Fair Queueing, simplified)
+// ----------------------------------------------------------------
+// Every process has its own queue. The scheduler hands the disk to one
+// process at a time for a "slot" in which it may dispatch up to
+// BFQ_MAX_BUDGET of its requests (nearest first). Slots are given out in
+// order of weighted virtual finish time, so a process with weight 2 gets
+// twice the service of a weight-1 process and nobody is starved.
+#define BFQ_MAX_BUDGET 4
+
+void bfq(int requests[], int sector[], int pid[], int weight[], int n, int head) {
+    int nproc = 0;
+    for (int i = 0; i < n; i++) {
+        if (pid[i] + 1 > nproc) nproc = pid[i] + 1;
+    }
+
+    int *serviced = calloc(n, sizeof(int));
+    int *pending = calloc(nproc, sizeof(int));      // queued requests per process
+    double *vstart = calloc(nproc, sizeof(double)); // virtual start of next slot
+    double *vfinish = calloc(nproc, sizeof(double));// virtual finish of next slot
+    for (int i = 0; i < n; i++) pending[pid[i]]++;
+    for (int p = 0; p < nproc; p++) {
+        vfinish[p] = (double) BFQ_MAX_BUDGET / weight[p];
+    }
+
+    int serviced_count = 0;
+    double vtime = 0.0;
+    head_t h;
+
+    head_begin(&h, "BFQ", requests, sector, head);
+
+    while (serviced_count < n) {
+        // Pick the eligible process (start <= vtime) that finishes first
+        int active = -1;
+        int weight_sum = 0;
+        for (int p = 0; p < nproc; p++) {
+            if (pending[p] == 0) continue;
+            weight_sum += weight[p];
+            if (vstart[p] <= vtime && (active == -1 || vfinish[p] < vfinish[active])) {
+                active = p;
+            }
+        }
+        if (active == -1) {
+            // Nobody eligible yet: jump virtual time to the earliest start
+            double next = -1.0;
+            for (int p = 0; p < nproc; p++) {
+                if (pending[p] > 0 && (next < 0 || vstart[p] < next)) next = vstart[p];
+            }
+            vtime = next;
+            continue;
+        }
+
+        // Serve the process until its budget runs out or its queue is empty
+        int used = 0;
+        while (used < BFQ_MAX_BUDGET && pending[active] > 0) {
+            int min_distance = INT_MAX;
+            int index = -1;
+            for (int i = 0; i < n; i++) {
+                if (serviced[i] == 0 && pid[i] == active) {
+                    int distance = abs(h.pos - requests[i]);
+                    if (distance < min_distance) {
+                        min_distance = distance;
+                        index = i;
+                    }
+                }
+            }
+            head_service(&h, index);
+            serviced[index] = 1;
+            serviced_count++;
+            pending[active]--;
+            used++;
+        }
+
+        // Charge the service actually received, not the full budget
+        vtime += (double) used / weight_sum;
+        vstart[active] += (double) used / weight[active];
+        vfinish[active] = vstart[active] + (double) BFQ_MAX_BUDGET / weight[active];
+    }
+    head_end(&h);
+
+    free(serviced);
+    free(pending);
+    free(vstart);
+    free(vfinish);
+}
+
+// ----------------------------------------------------------------
+// 6. SATF: Shortest Access Time First
+// ----------------------------------------------------------------
+// Like SSTF, but "closest" means lowest seek + rotational wait according
+// to the disk model, so a far request whose sector is about to pass under
+// the head can beat a near one that just went by.
+void satf(int requests[], int sector[], int n, int head) {
+    int *serviced = calloc(n, sizeof(int));
+    int serviced_count = 0;
+    head_t h;
+
+    head_begin(&h, "SATF", requests, sector, head);
+
+    while (serviced_count < n) {
+        double best_time = 0.0;
+        int index = -1;
+        for (int i = 0; i < n; i++) {
+            if (serviced[i] == 0) {
+                double t = access_time_ms(&h, requests[i], sector[i]);
+                if (index == -1 || t < best_time) {
+                    best_time = t;
+                    index = i;
+                }
+            }
+        }
+        head_service(&h, index);
+        serviced[index] = 1;
+        serviced_count++;
+    }
+    head_end(&h);
+
+    free(serviced);
+}
+
+// ----------------------------------------------------------------
+// 7. Merge stage (front/back merging before dispatch)
+// ----------------------------------------------------------------
+// Like the block layer, requests that land on the same or nearby
+// cylinders are coalesced into one dispatch before scheduling. Requests
+// are taken in cylinder order; each one is back-merged into the current
+// dispatch if it starts at most max_gap cylinders past its end and the
+// dispatch holds fewer than max_count requests. Over a whole batch that
+// is the same result as the block layer's front and back merges.
+typedef struct {
+    int n;          // number of merged dispatches
+    int *start;     // first cylinder (what the algorithms schedule on)
+    int *end;       // last cylinder covered
+    int *sector;    // sector of the first member
+    int *first;     // members of dispatch i are member[first[i] .. first[i+1]-1]
+    int *member;    // original request indices
+} merge_t;
+
+merge_t merge_requests(const int requests[], const int sector[], int n, int max_gap, int max_count) {
+    merge_t m;
+    m.n = 0;
+    m.start = malloc(n * sizeof(int));
+    m.end = malloc(n * sizeof(int));
+    m.sector = malloc(n * sizeof(int));
+    m.first = malloc((n + 1) * sizeof(int));
+    m.member = malloc(n * sizeof(int));
+
+    for (int i = 0; i < n; i++) m.member[i] = i;
+    sort_key = requests;
+    qsort(m.member, n, sizeof(int), compare_idx);
+
+    for (int k = 0; k < n; k++) {
+        int i = m.member[k];
+        int cur = m.n - 1;
+        if (cur >= 0 && requests[i] - m.end[cur] <= max_gap &&
+            k - m.first[cur] < max_count) {
+            // Back merge into the current dispatch
+            m.end[cur] = requests[i];
+        } else {
+            // Start a new dispatch
+            m.start[m.n] = requests[i];
+            m.end[m.n] = requests[i];
+            m.sector[m.n] = sector[i];
+            m.first[m.n] = k;
+            m.n++;
+        }
+    }
+    m.first[m.n] = n;
+    return m;
+}
+
+// Translate a service order over merged dispatches back into the
+// original request IDs, in completion order
+void merge_expand(const merge_t *m, const int order[], int completed[]) {
+    int k = 0;
+    for (int d = 0; d < m->n; d++) {
+        int i = order[d];
+        for (int j = m->first[i]; j < m->first[i + 1]; j++) {
+            completed[k++] = m->member[j];
+        }
+    }
+}
+
+void merge_free(merge_t *m) {
+    free(m->start);
+    free(m->end);
+    free(m->sector);
+    free(m->first);
+    free(m->member);
+}
+
+#endif // DISK_SCHED_H
@@ -0,0 +1,404 @@
+/*
+ * io_replay.c
+ *
+ * Replay disk schedules against a real file.
+ *
+ * Compile:
+ *   gcc -O2 -o io_replay io_replay.c -lm
+ *
+ * Run:
+ *   ./io_replay <test_file> [requests] [queue_depth] [block_size] [direct] [grow]
+ *
+ * Example:
+ *   ./io_replay /mnt/scratch/replay.dat 4000 8 4096 1
+ *
+ * What it does:
+ *  - Makes sure <test_file> is FILE_MB large and filled with real data
+ *    (sparse files would not touch the disk). A new file is created and
+ *    filled; an existing one must be a regular file and is only read.
+ *    If it is smaller than FILE_MB it is refused, unless grow=1 says it
+ *    may be overwritten with test data. Devices are always refused (a
+ *    block device reports size 0 and would be overwritten).
+ *  - Generates random (cylinder, sector) requests, like the other disk
+ *    programs. Cylinder c maps to the c-th of CYLINDERS equal slices of
+ *    the file; the sector picks a block inside that slice.
+ *  - For each algorithm (fifo, sstf, scan, clook, satf) it asks
+ *    disk_sched.h for the service order and issues the reads in exactly
+ *    that order, keeping up to queue_depth reads in flight with io_uring.
+ *  - If io_uring is not available it falls back to one pread() at a time.
+ *  - direct=1 (default) opens the file with O_DIRECT so the page cache
+ *    does not hide the access pattern; block_size must then be a multiple
+ *    of the device's logical block size.
+ *
+ * Output:
+ *   MB/s and mean/p50/p99 read latency per algorithm.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "disk_sched.h"
+
+#define FILE_MB     256
+#define CYLINDERS   1000
+
+// ----------------------------------------------------------------
+// Minimal io_uring wrapper (raw system calls, no liburing needed)
+// ----------------------------------------------------------------
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+} uring_t;
+
+int uring_init(uring_t *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+    r->sq_ptr = r->cq_ptr = r->sqes = MAP_FAILED;   // nothing to unmap yet
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+        r->cq_size = r->sq_size;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) goto fail;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    if (r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_size);
+    close(r->fd);
+    return -1;
+}
+
+void uring_exit(uring_t *r) {
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+    munmap(r->sq_ptr, r->sq_size);
+    close(r->fd);
+}
+
+// Queue one read; it is handed to the kernel by the next uring_enter()
+void uring_prep_read(uring_t *r, int fd, void *buf, unsigned len, off_t offset, unsigned long long tag) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) buf;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = tag;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+int uring_enter(uring_t *r, unsigned to_submit, unsigned min_complete) {
+    return (int) syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete,
+                         min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// ----------------------------------------------------------------
+// Replay
+// ----------------------------------------------------------------
+double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Fill the file with non-zero data so reads really hit the device
+int prepare_file(int fd, off_t size) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    if (st.st_size >= size) return 0;
+
+    size_t chunk = 1 << 20;
+    char *buf = malloc(chunk);
+    memset(buf, 0xA5, chunk);
+    for (off_t off = 0; off < size; off += chunk) {
+        if (pwrite(fd, buf, chunk, off) != (ssize_t) chunk) {
+            free(buf);
+            return -1;
+        }
+    }
+    free(buf);
+    return fsync(fd);
+}
+
+// Issue reads in order[] with up to qd in flight; returns elapsed seconds
+// and stores per-read latency (microseconds) in latency[]
+double replay(uring_t *ring, int use_uring, int fd, const off_t offset[],
+              const int order[], int n, int qd, int block_size,
+              char **buf, double latency[]) {
+    double start = now_us();
+
+    if (!use_uring) {
+        for (int k = 0; k < n; k++) {
+            double t0 = now_us();
+            if (pread(fd, buf[0], block_size, offset[order[k]]) != block_size) {
+                perror("pread");
+                exit(1);
+            }
+            latency[k] = now_us() - t0;
+        }
+        return (now_us() - start) / 1e6;
+    }
+
+    double *issued = malloc(qd * sizeof(double));
+    int *free_slot = malloc(qd * sizeof(int));
+    int nfree = qd;
+    for (int i = 0; i < qd; i++) free_slot[i] = qd - 1 - i;
+
+    int next = 0, done = 0, inflight = 0;
+    unsigned unsubmitted = 0;   // queued in the SQ ring, not yet taken by the kernel
+    while (done < n) {
+        // Top up the submission ring in schedule order
+        while (next < n && inflight < qd) {
+            int slot = free_slot[--nfree];
+            issued[slot] = now_us();
+            uring_prep_read(ring, fd, buf[slot], block_size, offset[order[next]],
+                            ((unsigned long long) next << 32) | slot);
+            next++;
+            inflight++;
+            unsubmitted++;
+        }
+        // Returns how many SQEs the kernel took; after EINTR (or a short
+        // submit) the rest are still in the ring and go with the next call
+        int submitted = uring_enter(ring, unsubmitted, 1);
+        if (submitted >= 0) {
+            unsubmitted -= submitted;
+        } else if (errno != EINTR) {
+            perror("io_uring_enter");
+            exit(1);
+        }
+
+        // Reap whatever has completed
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        double t = now_us();
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->res != block_size) {
+                fprintf(stderr, "read failed: %s\n", strerror(cqe->res < 0 ? -cqe->res : EIO));
+                exit(1);
+            }
+            int slot = (int)(cqe->user_data & 0xffffffffu);
+            latency[done++] = t - issued[slot];
+            free_slot[nfree++] = slot;
+            inflight--;
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    free(issued);
+    free(free_slot);
+    return (now_us() - start) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 7) {
+        fprintf(stderr, "Usage: %s <test_file> [requests] [queue_depth] [block_size] [direct] [grow]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    int n = (argc > 2) ? atoi(argv[2]) : 4000;
+    int qd = (argc > 3) ? atoi(argv[3]) : 8;
+    int block_size = (argc > 4) ? atoi(argv[4]) : 4096;
+    int direct = (argc > 5) ? atoi(argv[5]) : 1;
+    int grow = (argc > 6) ? atoi(argv[6]) : 0;
+
+    off_t file_size = (off_t) FILE_MB << 20;
+    off_t slice = file_size / CYLINDERS;
+    if (n <= 0 || qd <= 0 || block_size <= 0 || block_size % 512 != 0 || block_size > slice) {
+        fprintf(stderr, "requests and queue_depth must be positive; block_size a multiple of 512 up to %ld\n",
+                (long) slice);
+        return 1;
+    }
+
+    // Create and fill the file with normal buffered I/O first. Never
+    // write to something that already exists unless grow says so.
+    int created = 1;
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        created = 0;
+        fd = open(path, (grow ? O_RDWR : O_RDONLY) | O_NONBLOCK);   // no hang on a FIFO
+    }
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "%s is not a regular file; refusing to use it\n", path);
+        return 1;
+    }
+    if (st.st_size < file_size) {
+        if (!created && !grow) {
+            fprintf(stderr, "%s exists and is smaller than %d MB; pass grow=1 to overwrite it with test data\n",
+                    path, FILE_MB);
+            return 1;
+        }
+        if (prepare_file(fd, file_size) < 0) {
+            perror(path);
+            return 1;
+        }
+    }
+    close(fd);
+
+    fd = open(path, O_RDONLY | (direct ? O_DIRECT : 0));
+    if (fd < 0 && direct) {
+        fprintf(stderr, "O_DIRECT not supported on %s, using buffered reads\n", path);
+        direct = 0;
+        fd = open(path, O_RDONLY);
+    }
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    uring_t ring;
+    int use_uring = (uring_init(&ring, qd) == 0);
+    if (!use_uring) {
+        fprintf(stderr, "io_uring unavailable (%s), falling back to pread at QD 1\n", strerror(errno));
+    }
+
+    // One aligned buffer per in-flight read
+    char **buf = malloc(qd * sizeof(char *));
+    for (int i = 0; i < qd; i++) {
+        if (posix_memalign((void **) &buf[i], 4096, block_size) != 0) {
+            perror("posix_memalign");
+            return 1;
+        }
+    }
+
+    // Requests: cylinder + sector, mapped to a block-aligned file offset
+    int blocks_per_slice = (int)(slice / block_size);
+    slice = (off_t) blocks_per_slice * block_size;
+    int *requests = malloc(n * sizeof(int));
+    int *sector = malloc(n * sizeof(int));
+    off_t *offset = malloc(n * sizeof(off_t));
+    int *order = malloc(n * sizeof(int));
+    double *latency = malloc(n * sizeof(double));
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        requests[i] = rand() % CYLINDERS;
+        sector[i] = rand() % disk.sectors_per_track;
+        offset[i] = requests[i] * slice +
+                    (off_t)(sector[i] % blocks_per_slice) * block_size;
+    }
+
+    disk.cylinders = CYLINDERS;
+    disk_geom_calibrate(&disk, 1.0, 8.0, 15.0);
+
+    printf("File: %s (%d MB, %s, %s), %d reads of %d bytes, QD %d\n\n",
+           path, FILE_MB, direct ? "O_DIRECT" : "buffered",
+           use_uring ? "io_uring" : "pread", n, block_size, use_uring ? qd : 1);
+    printf("%-6s %10s %9s %9s %9s %9s\n",
+           "sched", "seek(cyl)", "MB/s", "mean(us)", "p50(us)", "p99(us)");
+
+    const char *algos[] = {"fifo", "sstf", "scan", "clook", "satf"};
+    char direction[] = "right";
+    int head = CYLINDERS / 2;
+
+    for (int a = 0; a < 5; a++) {
+        sched.quiet = 1;
+        sched.order = order;
+        if (strcmp(algos[a], "sstf") == 0) {
+            sstf(requests, sector, n, head);
+        } else if (strcmp(algos[a], "scan") == 0) {
+            scan(requests, sector, n, head, CYLINDERS - 1, direction);
+        } else if (strcmp(algos[a], "clook") == 0) {
+            clook(requests, sector, n, head, direction);
+        } else if (strcmp(algos[a], "satf") == 0) {
+            satf(requests, sector, n, head);
+        } else { // fifo
+            for (int i = 0; i < n; i++) order[i] = i;
+        }
+        sched.order = NULL;
+        sched.quiet = 0;
+
+        long seek = 0;
+        int pos = head;
+        for (int i = 0; i < n; i++) {
+            seek += abs(requests[order[i]] - pos);
+            pos = requests[order[i]];
+        }
+
+        // Drop cached pages so buffered runs don't benefit from earlier ones
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+        double secs = replay(&ring, use_uring, fd, offset, order, n, qd,
+                             block_size, buf, latency);
+        double sum = 0.0;
+        for (int i = 0; i < n; i++) sum += latency[i];
+        qsort(latency, n, sizeof(double), compare_double);
+
+        printf("%-6s %10ld %9.2f %9.1f %9.1f %9.1f\n", algos[a], seek,
+               (double) n * block_size / (1 << 20) / secs, sum / n,
+               latency[(int)(0.50 * (n - 1))], latency[(int)(0.99 * (n - 1))]);
+    }
+
+    if (use_uring) uring_exit(&ring);
+    for (int i = 0; i < qd; i++) free(buf[i]);
+    free(buf);
+    free(requests);
+    free(sector);
+    free(offset);
+    free(order);
+    free(latency);
+    close(fd);
+    return 0;
+}
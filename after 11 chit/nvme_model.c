@@ -0,0 +1,337 @@
+/*
+ * nvme_model.c
+ *
+ * Multi-queue SSD/NVMe device model with parallel channels and dies.
+ *
+ * Compile:
+ *   gcc -O2 -o nvme_model nvme_model.c -lm
+ *
+ * Run:
+ *   ./nvme_model [requests] [queues]
+ *
+ * Model:
+ *  - The device has C channels with DIES_PER_CHANNEL dies each. Pages are
+ *    striped across dies (lba % dies), so consecutive LBAs hit different
+ *    dies.
+ *  - A read keeps its die busy for T_READ_US, then moves the page over the
+ *    channel bus (T_XFER_US). A write moves the page first, then programs
+ *    it (T_PROG_US). Every PAGES_PER_BLOCK programs a die also pays one
+ *    block erase (T_ERASE_US), a crude stand-in for garbage collection.
+ *  - The host owns Q submission/completion ring pairs of depth QD. It keeps
+ *    each ring full, the device fetches round-robin across submission
+ *    rings and posts completions to the matching completion ring.
+ *
+ * The host hands requests to the rings in the order produced by one of
+ * the disk schedulers from disk_sched.h (LBA used as the "cylinder"),
+ * applied to windows of Q*QD requests, i.e. what could be in flight at
+ * once. "fifo" keeps arrival order.
+ *
+ * Output:
+ *   IOPS and latency percentiles for every scheduler, channel count and
+ *   queue depth, so you can see whether elevator-style reordering buys
+ *   anything on a device without a moving head.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "disk_sched.h"
+
+#define DIES_PER_CHANNEL   4
+#define T_READ_US       50.0    // array read (tR)
+#define T_PROG_US      500.0    // page program (tPROG)
+#define T_ERASE_US    3000.0    // block erase (tBERS)
+#define T_XFER_US        5.0    // 4 KiB over one channel bus (~800 MB/s)
+#define PAGES_PER_BLOCK  256
+#define WRITE_PERCENT     30
+#define LBA_SPACE   (1 << 20)   // 4 GiB of 4 KiB pages
+
+// ----------------------------------------------------------------
+// Submission / completion rings
+// ----------------------------------------------------------------
+typedef struct {
+    int req;            // request index
+    double submit_us;   // when the host placed it in the ring
+} sq_entry_t;
+
+typedef struct {
+    int req;
+    double complete_us;
+} cq_entry_t;
+
+// Head/tail counters only ever grow; slot = counter % depth
+typedef struct {
+    int depth;
+    sq_entry_t *sq;
+    unsigned sq_head, sq_tail;  // device consumes at head, host produces at tail
+    cq_entry_t *cq;
+    unsigned cq_head, cq_tail;  // host consumes at head, device produces at tail
+    int outstanding;            // submitted but not yet reaped
+} queue_pair_t;
+
+// ----------------------------------------------------------------
+// Device state
+// ----------------------------------------------------------------
+typedef struct {
+    int channels;
+    int dies;               // channels * DIES_PER_CHANNEL
+    double *die_free_us;    // when each die goes idle
+    double *chan_free_us;   // when each channel bus goes idle
+    int *programs;          // pages programmed per die since the last erase
+} nvme_dev_t;
+
+// Pending completions, kept in a binary min-heap on completion time
+typedef struct {
+    double time_us;
+    int queue;
+    int req;
+    double submit_us;
+} event_t;
+
+typedef struct {
+    event_t *ev;
+    int size;
+} event_heap_t;
+
+void heap_push(event_heap_t *h, event_t e) {
+    int i = h->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (h->ev[parent].time_us <= e.time_us) break;
+        h->ev[i] = h->ev[parent];
+        i = parent;
+    }
+    h->ev[i] = e;
+}
+
+event_t heap_pop(event_heap_t *h) {
+    event_t top = h->ev[0];
+    event_t last = h->ev[--h->size];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->ev[child + 1].time_us < h->ev[child].time_us) child++;
+        if (last.time_us <= h->ev[child].time_us) break;
+        h->ev[i] = h->ev[child];
+        i = child;
+    }
+    h->ev[i] = last;
+    return top;
+}
+
+double max2(double a, double b) { return a > b ? a : b; }
+
+// Execute one command on its die and return its completion time
+double device_execute(nvme_dev_t *d, int lba, int is_write, double now) {
+    int die = lba % d->dies;
+    int ch = die % d->channels;
+    double done;
+
+    if (is_write) {
+        // Data goes over the bus first, then the die programs it
+        double xfer_start = max2(now, d->chan_free_us[ch]);
+        d->chan_free_us[ch] = xfer_start + T_XFER_US;
+        double prog_start = max2(d->chan_free_us[ch], d->die_free_us[die]);
+        done = prog_start + T_PROG_US;
+        if (++d->programs[die] == PAGES_PER_BLOCK) {
+            d->programs[die] = 0;
+            done += T_ERASE_US;
+        }
+        d->die_free_us[die] = done;
+    } else {
+        // The die senses the page, then it goes over the bus
+        double read_start = max2(now, d->die_free_us[die]);
+        double xfer_start = max2(read_start + T_READ_US, d->chan_free_us[ch]);
+        done = xfer_start + T_XFER_US;
+        d->chan_free_us[ch] = done;
+        d->die_free_us[die] = done;
+    }
+    return done;
+}
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double iops;
+    double mean_us, p50_us, p99_us, p999_us;
+} result_t;
+
+// Run n requests through the device, submitted in the given order
+result_t simulate(int channels, int nqueues, int qd,
+                  const int lba[], const int is_write[], const int order[], int n) {
+    nvme_dev_t d;
+    d.channels = channels;
+    d.dies = channels * DIES_PER_CHANNEL;
+    d.die_free_us = calloc(d.dies, sizeof(double));
+    d.chan_free_us = calloc(channels, sizeof(double));
+    d.programs = calloc(d.dies, sizeof(int));
+
+    queue_pair_t *q = calloc(nqueues, sizeof(queue_pair_t));
+    for (int i = 0; i < nqueues; i++) {
+        q[i].depth = qd;
+        q[i].sq = malloc(qd * sizeof(sq_entry_t));
+        q[i].cq = malloc(qd * sizeof(cq_entry_t));
+    }
+
+    event_heap_t events = { malloc(nqueues * qd * sizeof(event_t)), 0 };
+    double *latency = malloc(n * sizeof(double));
+    int next = 0;       // next request (position in order[]) to submit
+    int done = 0;
+    int rr = 0;         // round-robin cursor for device arbitration
+    double now = 0.0;
+
+    while (done < n) {
+        // Host: top up every submission ring
+        for (int i = 0; i < nqueues && next < n; i++) {
+            while (next < n && q[i].outstanding < qd) {
+                sq_entry_t *e = &q[i].sq[q[i].sq_tail % qd];
+                e->req = order[next++];
+                e->submit_us = now;
+                q[i].sq_tail++;
+                q[i].outstanding++;
+            }
+        }
+
+        // Device: fetch one command per ring in turn until all are empty
+        int fetched = 1;
+        while (fetched) {
+            fetched = 0;
+            for (int k = 0; k < nqueues; k++) {
+                int i = (rr + k) % nqueues;
+                if (q[i].sq_head == q[i].sq_tail) continue;
+                sq_entry_t e = q[i].sq[q[i].sq_head % qd];
+                q[i].sq_head++;
+                event_t ev = { device_execute(&d, lba[e.req], is_write[e.req], now),
+                               i, e.req, e.submit_us };
+                heap_push(&events, ev);
+                fetched = 1;
+            }
+            rr = (rr + 1) % nqueues;
+        }
+
+        // Advance to the next completion and post it to its ring
+        event_t ev = heap_pop(&events);
+        now = ev.time_us;
+        queue_pair_t *cq = &q[ev.queue];
+        cq->cq[cq->cq_tail % qd] = (cq_entry_t){ ev.req, ev.time_us };
+        cq->cq_tail++;
+
+        // Host: reap the completion ring
+        while (cq->cq_head != cq->cq_tail) {
+            cq->cq_head++;
+            latency[done++] = ev.time_us - ev.submit_us;
+            cq->outstanding--;
+        }
+    }
+
+    result_t r;
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += latency[i];
+    qsort(latency, n, sizeof(double), compare_double);
+    r.iops = n / (now / 1e6);
+    r.mean_us = sum / n;
+    r.p50_us = latency[(int)(0.50 * (n - 1))];
+    r.p99_us = latency[(int)(0.99 * (n - 1))];
+    r.p999_us = latency[(int)(0.999 * (n - 1))];
+
+    for (int i = 0; i < nqueues; i++) {
+        free(q[i].sq);
+        free(q[i].cq);
+    }
+    free(q);
+    free(events.ev);
+    free(latency);
+    free(d.die_free_us);
+    free(d.chan_free_us);
+    free(d.programs);
+    return r;
+}
+
+// Build the submission order by running a disk scheduler over each
+// window of requests the host could have in flight at once
+void build_order(const char *name, const int lba[], int n, int window, int order[]) {
+    int *win = malloc(window * sizeof(int));
+    int *sector = calloc(window, sizeof(int));   // SSDs have no rotation
+    int *idx = malloc(window * sizeof(int));
+    char direction[] = "right";
+    int head = 0;
+
+    sched.quiet = 1;
+    for (int start = 0; start < n; start += window) {
+        int w = (n - start < window) ? n - start : window;
+        for (int i = 0; i < w; i++) win[i] = lba[start + i];
+
+        sched.order = idx;
+        if (strcmp(name, "sstf") == 0) {
+            sstf(win, sector, w, head);
+        } else if (strcmp(name, "scan") == 0) {
+            scan(win, sector, w, head, LBA_SPACE - 1, direction);
+        } else if (strcmp(name, "clook") == 0) {
+            clook(win, sector, w, head, direction);
+        } else { // fifo
+            for (int i = 0; i < w; i++) idx[i] = i;
+            sched.last.pos = win[w - 1];
+        }
+        for (int i = 0; i < w; i++) order[start + i] = start + idx[i];
+        head = sched.last.pos;
+    }
+    sched.order = NULL;
+    sched.quiet = 0;
+
+    free(win);
+    free(sector);
+    free(idx);
+}
+
+int main(int argc, char *argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : 20000;
+    int nqueues = (argc > 2) ? atoi(argv[2]) : 4;
+    if (n <= 0 || nqueues <= 0) {
+        fprintf(stderr, "Usage: %s [requests] [queues]\n", argv[0]);
+        return 1;
+    }
+
+    // Random 4 KiB reads and writes over the whole LBA space
+    int *lba = malloc(n * sizeof(int));
+    int *is_write = malloc(n * sizeof(int));
+    int *order = malloc(n * sizeof(int));
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        lba[i] = rand() % LBA_SPACE;
+        is_write[i] = (rand() % 100) < WRITE_PERCENT;
+    }
+
+    const char *algos[] = {"fifo", "sstf", "scan", "clook"};
+    int channel_counts[] = {1, 2, 4, 8};
+    int depths[] = {1, 4, 16, 64};
+
+    printf("Requests: %d (%d%% writes), %d queue pairs, %d dies/channel\n",
+           n, WRITE_PERCENT, nqueues, DIES_PER_CHANNEL);
+    printf("tR=%.0fus tPROG=%.0fus tBERS=%.0fus xfer=%.0fus\n\n",
+           T_READ_US, T_PROG_US, T_ERASE_US, T_XFER_US);
+    printf("%-6s %4s %5s %10s %9s %9s %9s %9s\n",
+           "sched", "chan", "QD", "IOPS", "mean(us)", "p50(us)", "p99(us)", "p99.9(us)");
+
+    for (int c = 0; c < 4; c++) {
+        for (int q = 0; q < 4; q++) {
+            for (int a = 0; a < 4; a++) {
+                build_order(algos[a], lba, n, nqueues * depths[q], order);
+                result_t r = simulate(channel_counts[c], nqueues, depths[q],
+                                      lba, is_write, order, n);
+                printf("%-6s %4d %5d %10.0f %9.1f %9.1f %9.1f %9.1f\n",
+                       algos[a], channel_counts[c], depths[q], r.iops,
+                       r.mean_us, r.p50_us, r.p99_us, r.p999_us);
+            }
+        }
+        printf("\n");
+    }
+
+    free(lba);
+    free(is_write);
+    free(order);
+    return 0;
+}
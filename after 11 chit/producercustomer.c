@@ -3,12 +3,16 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <string.h>
+
+#include "../futex_sync.h"
 
 // Define the size of the shared buffer
 #define BUFFER_SIZE 5
 #define NUM_PRODUCERS 2
 #define NUM_CONSUMERS 2
 #define ITEMS_PER_PRODUCER 8
+#define BATCH 4 // Items a producer hands over at once / a consumer takes at most
 
 // --- Global Variables ---
 
@@ -22,41 +26,108 @@ sem_t full;  // Counts items in the buffer
 sem_t empty; // Counts empty slots
 sem_t mutex; // Binary semaphore for mutual exclusion
 
+// The same three with futex_sync.h ("futex" on the command line): they
+// spin briefly before sleeping, and take / give a whole run in one go
+int use_futex = 0;
+fsem_t ffull, fempty;
+fmutex_t fmutex;
+
+/**
+ * @brief Waits for one unit of s (or fs), then takes up to max - 1 more
+ * without blocking. Returns how many units it got.
+ */
+int sem_wait_n(sem_t *s, fsem_t *fs, int max) {
+    if (use_futex) return fsem_wait_n(fs, max);
+    int n = 1;
+    sem_wait(s);
+    while (n < max && sem_trywait(s) == 0) n++;
+    return n;
+}
+
+void sem_post_n(sem_t *s, fsem_t *fs, int n) {
+    if (use_futex) fsem_post_n(fs, n);
+    else while (n-- > 0) sem_post(s);
+}
+
+void lock_buffer(void) {
+    if (use_futex) fmutex_lock(&fmutex);
+    else sem_wait(&mutex);
+}
+
+void unlock_buffer(void) {
+    if (use_futex) fmutex_unlock(&fmutex);
+    else sem_post(&mutex);
+}
+
+/**
+ * @brief Copies n items into the buffer at 'in' (the run may wrap around
+ * the end). Caller holds the mutex.
+ */
+void put_run(const int *items, int n) {
+    int first = (BUFFER_SIZE - in < n) ? BUFFER_SIZE - in : n;
+    memcpy(&buffer[in], items, first * sizeof(int));
+    memcpy(&buffer[0], items + first, (n - first) * sizeof(int));
+    in = (in + n) % BUFFER_SIZE;
+}
+
+/**
+ * @brief Copies n items out of the buffer from 'out'. Caller holds the mutex.
+ */
+void get_run(int *items, int n) {
+    int first = (BUFFER_SIZE - out < n) ? BUFFER_SIZE - out : n;
+    memcpy(items, &buffer[out], first * sizeof(int));
+    memcpy(items + first, &buffer[0], (n - first) * sizeof(int));
+    out = (out + n) % BUFFER_SIZE;
+}
+
 /**
  * @brief The producer thread's function.
+ *
+ * Items are produced BATCH at a time and handed over with one trip
+ * through the semaphores and the mutex (fewer if the buffer has fewer
+ * free slots).
  */
 void *producer(void *param) {
     int producer_id = *(int *)param;
 
-    for (int i = 0; i < ITEMS_PER_PRODUCER; i++) {
-        // Produce a new item (e.g., a random number)
-        int item = (producer_id * 100) + i; // Unique item for demo
-        
-        // --- Entry Section ---
-        
-        // 1. Wait for an empty slot.
-        // If buffer is full (empty == 0), this blocks.
-        sem_wait(&empty);
-        
-        // 2. Wait for the mutex to get exclusive access to the buffer.
-        sem_wait(&mutex);
-        
-        // --- Critical Section ---
-        // We are guaranteed to have an empty slot and exclusive access.
-        buffer[in] = item;
-        in = (in + 1) % BUFFER_SIZE;
-        printf("P-%d: Produced item %d. (Buffer slots used: %d)\n", 
-               producer_id, item, (in - out + BUFFER_SIZE) % BUFFER_SIZE);
-        // --- End Critical Section ---
-        
-        // 3. Release the mutex.
-        sem_post(&mutex);
-        
-        // 4. Signal that a new 'full' slot is available.
-        sem_post(&full);
-        
+    int items[BATCH];
+
+    for (int i = 0; i < ITEMS_PER_PRODUCER; ) {
+        // Produce a batch of new items (e.g., random numbers)
+        int count = 0;
+        while (count < BATCH && i < ITEMS_PER_PRODUCER) {
+            items[count++] = (producer_id * 100) + i; // Unique item for demo
+            i++;
+        }
+
+        for (int done = 0; done < count; ) {
+            // --- Entry Section ---
+
+            // 1. Wait for an empty slot, and take more if they are free.
+            // If buffer is full (empty == 0), this blocks.
+            int n = sem_wait_n(&empty, &fempty, count - done);
+
+            // 2. Wait for the mutex to get exclusive access to the buffer.
+            lock_buffer();
+
+            // --- Critical Section ---
+            // We are guaranteed n empty slots and exclusive access.
+            put_run(items + done, n);
+            printf("P-%d: Produced items %d..%d. (Buffer slots used: %d)\n",
+                   producer_id, items[done], items[done + n - 1],
+                   (in - out + BUFFER_SIZE) % BUFFER_SIZE);
+            // --- End Critical Section ---
+
+            // 3. Release the mutex.
+            unlock_buffer();
+
+            // 4. Signal that n new 'full' slots are available.
+            sem_post_n(&full, &ffull, n);
+            done += n;
+        }
+
         // Simulate time taken to produce
-        usleep(rand() % 100000); 
+        usleep(rand() % 100000);
     }
     
     printf("P-%d: Finished producing.\n", producer_id);
@@ -66,39 +137,45 @@ void *producer(void *param) {
 
 /**
  * @brief The consumer thread's function.
+ *
+ * Each round takes everything that is in the buffer, up to BATCH items
+ * (and never more than this consumer's share).
  */
 void *consumer(void *param) {
     int consumer_id = *(int *)param;
     // Each consumer will consume half of the total items
     int items_to_consume = (NUM_PRODUCERS * ITEMS_PER_PRODUCER) / NUM_CONSUMERS;
 
-    for (int i = 0; i < items_to_consume; i++) {
-        
+    int items[BATCH];
+
+    for (int i = 0; i < items_to_consume; ) {
+        int want = (items_to_consume - i < BATCH) ? items_to_consume - i : BATCH;
+
         // --- Entry Section ---
-        
-        // 1. Wait for a 'full' slot.
+
+        // 1. Wait for a 'full' slot, and take every other full one too.
         // If buffer is empty (full == 0), this blocks.
-        sem_wait(&full);
-        
+        int n = sem_wait_n(&full, &ffull, want);
+
         // 2. Wait for the mutex to get exclusive access.
-        sem_wait(&mutex);
-        
+        lock_buffer();
+
         // --- Critical Section ---
-        // We are guaranteed to have an item and exclusive access.
-        int item = buffer[out];
-        out = (out + 1) % BUFFER_SIZE;
-        printf("C-%d: Consumed item %d. (Buffer slots used: %d)\n", 
-               consumer_id, item, (in - out + BUFFER_SIZE) % BUFFER_SIZE);
+        // We are guaranteed to have n items and exclusive access.
+        get_run(items, n);
+        printf("C-%d: Consumed %d item(s), first %d. (Buffer slots used: %d)\n",
+               consumer_id, n, items[0], (in - out + BUFFER_SIZE) % BUFFER_SIZE);
         // --- End Critical Section ---
-        
+
         // 3. Release the mutex.
-        sem_post(&mutex);
-        
-        // 4. Signal that a new 'empty' slot is available.
-        sem_post(&empty);
-        
+        unlock_buffer();
+
+        // 4. Signal that n new 'empty' slots are available.
+        sem_post_n(&empty, &fempty, n);
+        i += n;
+
         // Simulate time taken to consume
-        usleep(rand() % 200000); 
+        usleep(rand() % 200000);
     }
 
     printf("C-%d: Finished consuming.\n", consumer_id);
@@ -109,7 +186,7 @@ void *consumer(void *param) {
 /**
  * @brief Main function to set up and run threads.
  */
-int main() {
+int main(int argc, char *argv[]) {
     pthread_t producers[NUM_PRODUCERS];
     pthread_t consumers[NUM_CONSUMERS];
 
@@ -122,6 +199,11 @@ int main() {
     sem_init(&empty, 0, BUFFER_SIZE);  // Initially, BUFFER_SIZE empty slots
     sem_init(&mutex, 0, 1);            // Initially, mutex is unlocked (value 1)
 
+    use_futex = (argc > 1 && strcmp(argv[1], "futex") == 0);
+    fsem_init(&ffull, 0);
+    fsem_init(&fempty, BUFFER_SIZE);
+    fmutex_init(&fmutex);
+
     // Create producer threads
     for (int i = 0; i < NUM_PRODUCERS; i++) {
         int *producer_id = malloc(sizeof(int));
@@ -154,4 +236,6 @@ int main() {
 }
 /*
 gcc producer_consumer.c -o producer_consumer -pthread
+./producer_consumer          (sem_t)
+./producer_consumer futex    (futex_sync.h)
 */
\ No newline at end of file
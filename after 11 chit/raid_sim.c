@@ -0,0 +1,229 @@
+/*
+ * raid_sim.c
+ *
+ * RAID-0 / RAID-10 / RAID-5 disk array scheduling simulation.
+ *
+ * Compile:
+ *   gcc -O2 -o raid_sim raid_sim.c -lm -pthread
+ *
+ * Run:
+ *   ./raid_sim <level> <disks|sweep> [sched] [requests] [write_percent]
+ *
+ * Examples:
+ *   ./raid_sim 0 4                  RAID-0 over 4 disks, SSTF
+ *   ./raid_sim 5 6 clook 50000 30   RAID-5 over 6 disks, C-LOOK, 30% writes
+ *   ./raid_sim 10 sweep scan        RAID-10 at every even width 2..16
+ *
+ * Model:
+ *  - Logical 4 KiB blocks are striped in chunks of CHUNK_BLOCKS.
+ *  - RAID-0: chunk k goes to disk k % N.
+ *  - RAID-10: disks form N/2 mirrored pairs, striped like RAID-0. Reads go
+ *    to whichever side of the pair has fewer queued requests, writes go
+ *    to both.
+ *  - RAID-5: left-symmetric layout with rotating parity. A read touches
+ *    one disk. A small write is read-modify-write: read old data and old
+ *    parity, then write both (two requests each on the data and the
+ *    parity disk).
+ *  - Each disk gets its own request queue and runs its own instance of
+ *    the chosen head scheduler (fifo, sstf, scan, clook, satf from
+ *    disk_sched.h) in its own thread.
+ *
+ * Output:
+ *   Per-disk request count, seek total and estimated busy time, then
+ *   aggregate throughput (logical requests / slowest disk's busy time)
+ *   and imbalance (slowest / average busy time).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "disk_sched.h"
+
+#define CHUNK_BLOCKS     16     // 64 KiB stripe unit
+#define BLOCKS_PER_CYL  256     // 1 MiB per cylinder
+#define DISK_CYLINDERS 8192     // 8 GiB per disk
+
+typedef struct {
+    int count;          // requests queued on this disk
+    int capacity;
+    int *requests;      // cylinder of each request
+    int *sector;        // sector of each request
+    const char *algo;
+    // results
+    long seek;
+    double time_ms;
+} disk_queue_t;
+
+void queue_add(disk_queue_t *q, long block) {
+    if (q->count == q->capacity) {
+        q->capacity = q->capacity ? 2 * q->capacity : 1024;
+        q->requests = realloc(q->requests, q->capacity * sizeof(int));
+        q->sector = realloc(q->sector, q->capacity * sizeof(int));
+    }
+    q->requests[q->count] = (int)(block / BLOCKS_PER_CYL);
+    q->sector[q->count] = (int)((block % BLOCKS_PER_CYL) * disk.sectors_per_track / BLOCKS_PER_CYL);
+    q->count++;
+}
+
+// Usable logical blocks for an array of n disks
+long array_blocks(int level, int n) {
+    long per_disk = (long) DISK_CYLINDERS * BLOCKS_PER_CYL;
+    if (level == 10) return per_disk * (n / 2);
+    if (level == 5) return per_disk * (n - 1);
+    return per_disk * n;
+}
+
+// Map one logical request onto the member disks
+void map_request(int level, int n, long lba, int is_write, disk_queue_t q[]) {
+    long chunk = lba / CHUNK_BLOCKS;
+    long offset = lba % CHUNK_BLOCKS;
+
+    if (level == 0) {
+        queue_add(&q[chunk % n], (chunk / n) * CHUNK_BLOCKS + offset);
+    } else if (level == 10) {
+        int pairs = n / 2;
+        int pair = (int)(chunk % pairs);
+        long block = (chunk / pairs) * CHUNK_BLOCKS + offset;
+        if (is_write) {
+            queue_add(&q[2 * pair], block);
+            queue_add(&q[2 * pair + 1], block);
+        } else {
+            int a = 2 * pair, b = 2 * pair + 1;
+            queue_add(&q[q[a].count <= q[b].count ? a : b], block);
+        }
+    } else { // RAID-5, left-symmetric
+        long row = chunk / (n - 1);
+        int parity = (n - 1) - (int)(row % n);
+        int data = (int)((chunk % (n - 1) + parity + 1) % n);
+        long block = row * CHUNK_BLOCKS + offset;
+        queue_add(&q[data], block);
+        if (is_write) {
+            // read-modify-write: old data + old parity in, new data + parity out
+            queue_add(&q[data], block);
+            queue_add(&q[parity], block);
+            queue_add(&q[parity], block);
+        }
+    }
+}
+
+// One thread per disk: run the chosen scheduler over its queue
+void *disk_worker(void *arg) {
+    disk_queue_t *q = arg;
+    char direction[] = "right";
+    int head = DISK_CYLINDERS / 2;
+
+    sched.quiet = 1;   // thread-local, so each disk has its own
+    if (q->count == 0) {
+        sched.last.total_seek = 0;
+        sched.last.time_ms = 0.0;
+    } else if (strcmp(q->algo, "sstf") == 0) {
+        sstf(q->requests, q->sector, q->count, head);
+    } else if (strcmp(q->algo, "scan") == 0) {
+        scan(q->requests, q->sector, q->count, head, DISK_CYLINDERS - 1, direction);
+    } else if (strcmp(q->algo, "clook") == 0) {
+        clook(q->requests, q->sector, q->count, head, direction);
+    } else if (strcmp(q->algo, "satf") == 0) {
+        satf(q->requests, q->sector, q->count, head);
+    } else { // fifo
+        head_t h;
+        head_begin(&h, "FIFO", q->requests, q->sector, head);
+        for (int i = 0; i < q->count; i++) head_service(&h, i);
+        head_end(&h);
+    }
+    q->seek = sched.last.total_seek;
+    q->time_ms = sched.last.time_ms;
+    return NULL;
+}
+
+typedef struct {
+    double throughput;    // logical requests per second
+    double imbalance;     // slowest disk / average disk busy time
+} array_result_t;
+
+array_result_t simulate(int level, int n, const char *algo, int requests,
+                        int write_percent, int verbose) {
+    disk_queue_t *q = calloc(n, sizeof(disk_queue_t));
+    for (int d = 0; d < n; d++) q[d].algo = algo;
+
+    // Same workload for every run: seed once per call
+    srand(1);
+    long blocks = array_blocks(level, n);
+    for (int i = 0; i < requests; i++) {
+        long lba = (((long) rand() << 31) | rand()) % blocks;
+        int is_write = (rand() % 100) < write_percent;
+        map_request(level, n, lba, is_write, q);
+    }
+
+    pthread_t *threads = malloc(n * sizeof(pthread_t));
+    for (int d = 0; d < n; d++) {
+        if (pthread_create(&threads[d], NULL, disk_worker, &q[d]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int d = 0; d < n; d++) pthread_join(threads[d], NULL);
+
+    double max_ms = 0.0, sum_ms = 0.0;
+    if (verbose) printf("%-6s %10s %14s %14s\n", "disk", "requests", "seek (cyl)", "busy (ms)");
+    for (int d = 0; d < n; d++) {
+        if (verbose) printf("%-6d %10d %14ld %14.1f\n", d, q[d].count, q[d].seek, q[d].time_ms);
+        if (q[d].time_ms > max_ms) max_ms = q[d].time_ms;
+        sum_ms += q[d].time_ms;
+    }
+
+    array_result_t r;
+    r.throughput = max_ms > 0 ? requests / (max_ms / 1000.0) : 0.0;
+    r.imbalance = sum_ms > 0 ? max_ms / (sum_ms / n) : 1.0;
+
+    for (int d = 0; d < n; d++) {
+        free(q[d].requests);
+        free(q[d].sector);
+    }
+    free(q);
+    free(threads);
+    return r;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 6) {
+        fprintf(stderr, "Usage: %s <0|10|5> <disks|sweep> [fifo|sstf|scan|clook|satf] [requests] [write_percent]\n",
+                argv[0]);
+        return 1;
+    }
+    int level = atoi(argv[1]);
+    int sweep = strcmp(argv[2], "sweep") == 0;
+    int disks = sweep ? 0 : atoi(argv[2]);
+    const char *algo = (argc > 3) ? argv[3] : "sstf";
+    int requests = (argc > 4) ? atoi(argv[4]) : 20000;
+    int write_percent = (argc > 5) ? atoi(argv[5]) : 30;
+
+    int min_disks = (level == 5) ? 3 : 2;
+    if ((level != 0 && level != 10 && level != 5) || requests <= 0 ||
+        write_percent < 0 || write_percent > 100 ||
+        (!sweep && (disks < min_disks || (level == 10 && disks % 2 != 0)))) {
+        fprintf(stderr, "Need RAID level 0, 10 or 5; at least %d disks (even for RAID-10); "
+                        "positive requests; write_percent 0..100\n", min_disks);
+        return 1;
+    }
+
+    disk.cylinders = DISK_CYLINDERS;
+    disk_geom_calibrate(&disk, 1.0, 8.0, 15.0);
+
+    printf("RAID-%d, %s, %d requests, %d%% writes, %d KiB chunks\n\n",
+           level, algo, requests, write_percent, CHUNK_BLOCKS * 4);
+
+    if (!sweep) {
+        array_result_t r = simulate(level, disks, algo, requests, write_percent, 1);
+        printf("\nAggregate throughput: %.0f requests/s\n", r.throughput);
+        printf("Imbalance (slowest / average disk): %.3f\n", r.imbalance);
+        return 0;
+    }
+
+    printf("%-6s %16s %16s %10s\n", "disks", "requests/s", "per disk", "imbalance");
+    for (int n = min_disks; n <= 16; n += (level == 10) ? 2 : 1) {
+        array_result_t r = simulate(level, n, algo, requests, write_percent, 0);
+        printf("%-6d %16.0f %16.0f %10.3f\n", n, r.throughput, r.throughput / n, r.imbalance);
+    }
+    return 0;
+}
@@ -2,16 +2,47 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "../futex_sync.h"
+#include "../cacheline.h"
+
+// A lock that is either a pthread mutex or, with "futex" on the command
+// line, the spin-then-park mutex from futex_sync.h. The latter may be
+// unlocked by any thread, which the last reader out needs. Each lock has
+// a cache line to itself, so readers bumping read_count under rw_mutex
+// do not disturb a writer spinning on resource_mutex.
+typedef struct {
+    CACHE_ALIGNED pthread_mutex_t p;
+    fmutex_t f;
+} lock_t;
+
+int use_futex = 0;
+
+void lock_init(lock_t *l) {
+    pthread_mutex_init(&l->p, NULL);
+    fmutex_init(&l->f);
+}
+
+void lock(lock_t *l) {
+    if (use_futex) fmutex_lock(&l->f);
+    else pthread_mutex_lock(&l->p);
+}
+
+void unlock(lock_t *l) {
+    if (use_futex) fmutex_unlock(&l->f);
+    else pthread_mutex_unlock(&l->p);
+}
 
 // --- Global Synchronization Variables ---
 
 // The mutex that protects the resource from WRITERS.
 // This is the "main" lock.
-pthread_mutex_t resource_mutex; 
+lock_t resource_mutex;
 
 // The mutex that protects the read_count variable.
 // This is a short-term lock for managing the counter.
-pthread_mutex_t rw_mutex; 
+lock_t rw_mutex;
 
 int read_count = 0; // Counts how many readers are active
 
@@ -31,7 +62,7 @@ void *reader(void *param) {
         // --- Reader Entry Section ---
         
         // 1. Lock the counter-mutex to safely change read_count
-        pthread_mutex_lock(&rw_mutex);
+        lock(&rw_mutex);
         
         read_count++;
         
@@ -39,11 +70,11 @@ void *reader(void *param) {
         if (read_count == 1) {
             // ...it must lock the resource to block any writers.
             printf("Reader %d: I am the FIRST reader. Locking resource for writers.\n", reader_id);
-            pthread_mutex_lock(&resource_mutex); 
+            lock(&resource_mutex); 
         }
         
         // 3. Unlock the counter-mutex. Other readers can now enter.
-        pthread_mutex_unlock(&rw_mutex);
+        unlock(&rw_mutex);
 
         
         // --- Critical Section (Reading) ---
@@ -56,7 +87,7 @@ void *reader(void *param) {
         // --- Reader Exit Section ---
         
         // 1. Lock the counter-mutex to safely change read_count
-        pthread_mutex_lock(&rw_mutex);
+        lock(&rw_mutex);
         
         read_count--;
         
@@ -64,11 +95,11 @@ void *reader(void *param) {
         if (read_count == 0) {
             // ...it must unlock the resource so writers can enter.
             printf("Reader %d: I am the LAST reader. Unlocking resource for writers.\n", reader_id);
-            pthread_mutex_unlock(&resource_mutex);
+            unlock(&resource_mutex);
         }
         
         // 3. Unlock the counter-mutex
-        pthread_mutex_unlock(&rw_mutex);
+        unlock(&rw_mutex);
 
         // Simulate thinking before reading again
         usleep(rand() % 200000);
@@ -93,7 +124,7 @@ void *writer(void *param) {
         // 1. No other writer is writing.
         // 2. No readers are reading (the 'last reader' has unlocked it).
         printf("Writer %d: Trying to lock resource...\n", writer_id);
-        pthread_mutex_lock(&resource_mutex);
+        lock(&resource_mutex);
 
         
         // --- Critical Section (Writing) ---
@@ -104,7 +135,7 @@ void *writer(void *param) {
 
         
         // --- Writer Exit Section ---
-        pthread_mutex_unlock(&resource_mutex);
+        unlock(&resource_mutex);
         printf("Writer %d: Unlocked resource.\n", writer_id);
 
         // Simulate working before writing again
@@ -118,15 +149,17 @@ void *writer(void *param) {
 /**
  * @brief Main function to create and manage threads.
  */
-int main() {
+int main(int argc, char *argv[]) {
     int num_readers = 5;
     int num_writers = 2;
     pthread_t readers[num_readers];
     pthread_t writers[num_writers];
 
+    use_futex = (argc > 1 && strcmp(argv[1], "futex") == 0);
+
     // Initialize the two mutexes
-    pthread_mutex_init(&rw_mutex, NULL);
-    pthread_mutex_init(&resource_mutex, NULL);
+    lock_init(&rw_mutex);
+    lock_init(&resource_mutex);
 
     // Create reader threads
     for (int i = 0; i < num_readers; i++) {
@@ -153,12 +186,21 @@ int main() {
     }
 
     // Clean up
-    pthread_mutex_destroy(&rw_mutex);
-    pthread_mutex_destroy(&resource_mutex);
+    pthread_mutex_destroy(&rw_mutex.p);
+    pthread_mutex_destroy(&resource_mutex.p);
 
     printf("Main: All threads finished. Final data value: %d\n", shared_data);
     return 0;
 } 
 /*
 gcc reader_writer.c -o reader_writer -pthread
+./reader_writer          (pthread mutexes)
+./reader_writer futex    (futex_sync.h)
+
+Lock-order check (see lockdep.c in the top directory):
+gcc -rdynamic reader_writer.c -o reader_writer -pthread
+LD_PRELOAD=./liblockdep.so ./reader_writer
+It reports resource_mutex being unlocked by a thread that did not lock
+it (the last reader is not always the first one), and the order
+resource_mutex -> rw_mutex in a reader that still holds resource_mutex.
 */
\ No newline at end of file
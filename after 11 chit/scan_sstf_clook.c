@@ -1,231 +1,156 @@
 #include <stdio.h>
-#include <stdlib.h> // For abs() and qsort()
-#include <limits.h> // For INT_MAX
-#include <string.h> // For memcpy() and strcmp()
-#include <math.h>   // For abs()
-
-// A helper function for qsort()
-int compare(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
-}
+#include <time.h>   // For clock_gettime()
 
-// ----------------------------------------------------------------
-// 1. SSTF: Shortest Seek Time First
-// ----------------------------------------------------------------
-void sstf(int requests[], int n, int head) {
-    // Create a copy of requests to avoid modifying the original
-    int req_copy[n];
-    memcpy(req_copy, requests, n * sizeof(int));
-
-    int total_seek = 0;
-    int serviced_count = 0;
-    int current_pos = head;
-
-    // We'll use an array to mark which requests are done
-    // 0 = not serviced, 1 = serviced
-    int serviced[n];
-    for (int i = 0; i < n; i++) {
-        serviced[i] = 0;
-    }
+#include "disk_sched.h"
 
-    printf("SSTF Path: %d", current_pos);
-
-    // Loop until all requests are serviced
-    while (serviced_count < n) {
-        int min_distance = INT_MAX;
-        int index = -1;
-
-        // Find the closest un-serviced request
-        for (int i = 0; i < n; i++) {
-            if (serviced[i] == 0) {
-                int distance = abs(current_pos - req_copy[i]);
-                if (distance < min_distance) {
-                    min_distance = distance;
-                    index = i;
-                }
-            }
-        }
+#define MERGE_GAP 2   // merge requests at most this many cylinders apart
+#define MERGE_MAX 4   // at most this many requests per dispatch
 
-        // Service the closest request
-        if (index != -1) {
-            total_seek += min_distance;
-            current_pos = req_copy[index];
-            serviced[index] = 1; // Mark as serviced
-            serviced_count++;
-            printf(" -> %d", current_pos);
-        }
-    }
-    printf("\nTotal SSTF Seek Time: %d\n\n", total_seek);
-}
+#define BENCH_CYLINDERS (1 << 20)
 
 // ----------------------------------------------------------------
-// 2. SCAN (Elevator Algorithm)
+// Benchmark: SCAN and C-LOOK on n random requests, output suppressed
 // ----------------------------------------------------------------
-void scan(int requests[], int n, int head, int disk_size, char *direction) {
-    // Create a copy and sort it
-    int sorted_req[n];
-    memcpy(sorted_req, requests, n * sizeof(int));
-    qsort(sorted_req, n, sizeof(int), compare);
-
-    int total_seek = 0;
-    int current_pos = head;
-
-    printf("SCAN Path: %d", current_pos);
-
-    if (strcmp(direction, "right") == 0) {
-        // --- Move Right (UP) ---
-        // Service all requests from head to the end
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] >= current_pos) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
-        
-        // Go to the very end of the disk
-        printf(" -> %d", disk_size);
-        total_seek += abs(disk_size - current_pos);
-        current_pos = disk_size;
-
-        // --- Move Left (DOWN) ---
-        // Service remaining requests from the end downwards
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] < head) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
-    } else { // Direction is "left"
-        // --- Move Left (DOWN) ---
-        // Service all requests from head to the beginning
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] <= current_pos) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
+int bench(int n) {
+    int *requests = malloc(n * sizeof(int));
+    int *sector = malloc(n * sizeof(int));
+    if (!requests || !sector) {
+        perror("malloc");
+        return 1;
+    }
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        requests[i] = rand() % BENCH_CYLINDERS;
+        sector[i] = rand() % disk.sectors_per_track;
+    }
+    disk.cylinders = BENCH_CYLINDERS;
+    disk_geom_calibrate(&disk, 1.0, 8.0, 15.0);
 
-        // Go to the very beginning of the disk
-        printf(" -> 0");
-        total_seek += abs(current_pos - 0);
-        current_pos = 0;
-
-        // --- Move Right (UP) ---
-        // Service remaining requests from 0 upwards
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] > head) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
+    char direction[] = "right";
+    sched.quiet = 1;
+    for (int a = 0; a < 2; a++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (a == 0) scan(requests, sector, n, BENCH_CYLINDERS / 2, BENCH_CYLINDERS - 1, direction);
+        else clook(requests, sector, n, BENCH_CYLINDERS / 2, direction);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        printf("%-7s %d requests: %.3f s (%.1f M requests/s), seek %ld, est. %.1f s of disk time\n",
+               sched.last.name, n, secs, n / secs / 1e6,
+               sched.last.total_seek, sched.last.time_ms / 1000.0);
     }
+    sched.quiet = 0;
 
-    printf("\nTotal SCAN Seek Time: %d\n\n", total_seek);
+    free(requests);
+    free(sector);
+    return 0;
 }
 
 // ----------------------------------------------------------------
-// 3. C-LOOK (Circular-LOOK)
+// Main function to run everything
 // ----------------------------------------------------------------
-void clook(int requests[], int n, int head, char *direction) {
-    // Create a copy and sort it
-    int sorted_req[n];
-    memcpy(sorted_req, requests, n * sizeof(int));
-    qsort(sorted_req, n, sizeof(int), compare);
-
-    int total_seek = 0;
-    int current_pos = head;
-
-    printf("C-LOOK Path: %d", current_pos);
-
-    if (strcmp(direction, "right") == 0) {
-        // --- Move Right (UP) ---
-        // Service all requests from head to the *last* request
-        for (int i = 0; i < n; i++) {
-            if (sorted_req[i] >= current_pos) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
-
-        // --- JUMP ---
-        // Jump from the last request (highest) to the first (lowest)
-        // Note: The jump itself is seek time!
-        total_seek += abs(current_pos - sorted_req[0]);
-        current_pos = sorted_req[0];
-        printf(" -> %d", current_pos);
-
-        // --- Move Right (UP) again ---
-        // Service remaining requests from the beginning
-        for (int i = 1; i < n; i++) {
-            if (sorted_req[i] < head) {
-                total_seek += abs(sorted_req[i] - current_pos);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            } else {
-                // We've reached the requests we already serviced
-                break;
-            }
-        }
-    } else { // Direction is "left"
-        // --- Move Left (DOWN) ---
-        // Service all requests from head to the *first* request
-        for (int i = n - 1; i >= 0; i--) {
-            if (sorted_req[i] <= current_pos) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            }
-        }
-
-        // --- JUMP ---
-        // Jump from the first request (lowest) to the last (highest)
-        total_seek += abs(sorted_req[n-1] - current_pos);
-        current_pos = sorted_req[n-1];
-        printf(" -> %d", current_pos);
-
-        // --- Move Left (DOWN) again ---
-        // Service remaining requests from the top
-        for (int i = n - 2; i >= 0; i--) {
-            if (sorted_req[i] > head) {
-                total_seek += abs(current_pos - sorted_req[i]);
-                current_pos = sorted_req[i];
-                printf(" -> %d", current_pos);
-            } else {
-                break;
-            }
+int main(int argc, char *argv[]) {
+    // "./scan_sstf_clook bench [n]" times SCAN and C-LOOK on n requests
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int n = (argc > 2) ? atoi(argv[2]) : 10000000;
+        if (n <= 0) {
+            fprintf(stderr, "Usage: %s bench [requests]\n", argv[0]);
+            return 1;
         }
+        return bench(n);
     }
 
-    printf("\nTotal C-LOOK Seek Time: %d\n\n", total_seek);
-}
-
-// ----------------------------------------------------------------
-// Main function to run everything
-// ----------------------------------------------------------------
-int main() {
     // Our list of "floors" (track requests)
     int requests[] = {98, 183, 37, 122, 14, 124, 65, 67};
     int n = sizeof(requests) / sizeof(requests[0]);
-    
+
     // Our "elevator's" starting position
     int head_start = 53;
-    
+
     // Total size of the "building" (disk)
     int disk_size = 199;
-    
+
     // Initial direction of the elevator
     char direction[] = "right";
 
+    // Sector (rotational position) of each request on its track
+    int sector[]   = {10, 57, 3, 88, 42, 15, 70, 21};
+
+    // Extra request details used by DEADLINE and BFQ
+    int is_write[] = {0, 1, 0, 0, 1, 0, 1, 0};     // 0 = read, 1 = write
+    int arrival[]  = {0, 0, 0, 10, 20, 30, 40, 60}; // when each request shows up
+    int pid[]      = {0, 1, 0, 2, 1, 2, 1, 0};      // issuing process
+    int weight[]   = {1, 1, 2};                     // BFQ weight per process
+
+    // A 7200 RPM drive: 1.0 ms track-to-track, 8.0 ms average and
+    // 15.0 ms full-stroke seek
+    disk.cylinders = disk_size + 1;
+    disk.rpm = 7200;
+    disk.sectors_per_track = 100;
+    disk_geom_calibrate(&disk, 1.0, 8.0, 15.0);
+    printf("Disk model: seek(d) = %.3f + %.3f*sqrt(d) + %.4f*d ms, %d RPM, %d sectors/track\n\n",
+           disk.settle_ms, disk.sqrt_coef_ms, disk.linear_coef_ms,
+           disk.rpm, disk.sectors_per_track);
+
     // Run each algorithm
     // We pass the ORIGINAL requests array each time
-    sstf(requests, n, head_start);
-    scan(requests, n, head_start, disk_size, direction);
-    clook(requests, n, head_start, direction);
+    sstf(requests, sector, n, head_start);
+    scan(requests, sector, n, head_start, disk_size, direction);
+    clook(requests, sector, n, head_start, direction);
+    deadline(requests, sector, is_write, arrival, n, head_start);
+    bfq(requests, sector, pid, weight, n, head_start);
+    satf(requests, sector, n, head_start);
+
+    // Merge stage: coalesce requests within MERGE_GAP cylinders (at most
+    // MERGE_MAX per dispatch) and compare the algorithms with and without it
+    merge_t m = merge_requests(requests, sector, n, MERGE_GAP, MERGE_MAX);
+    printf("Merge stage (gap <= %d cylinders, <= %d requests each): %d requests -> %d dispatches\n",
+           MERGE_GAP, MERGE_MAX, n, m.n);
+    for (int d = 0; d < m.n; d++) {
+        printf("  Dispatch %d: cylinders %d-%d <- requests", d, m.start[d], m.end[d]);
+        for (int j = m.first[d]; j < m.first[d + 1]; j++) printf(" R%d", m.member[j]);
+        printf("\n");
+    }
+
+    int order[n];
+    int completed[n];
+    printf("\n%-8s %12s %12s %12s %12s\n", "", "seek", "merged seek", "time (ms)", "merged (ms)");
+    for (int a = 0; a < 4; a++) {
+        const char *names[] = {"SSTF", "SCAN", "C-LOOK", "SATF"};
+        long seek[2];
+        double ms[2];
+        for (int merged = 0; merged < 2; merged++) {
+            int *req = merged ? m.start : requests;
+            int *sec = merged ? m.sector : sector;
+            int count = merged ? m.n : n;
+            sched.quiet = 1;
+            sched.order = order;
+            sched.end = merged ? m.end : NULL;
+            if (a == 0) sstf(req, sec, count, head_start);
+            else if (a == 1) scan(req, sec, count, head_start, disk_size, direction);
+            else if (a == 2) clook(req, sec, count, head_start, direction);
+            else satf(req, sec, count, head_start);
+            seek[merged] = sched.last.total_seek;
+            ms[merged] = sched.last.time_ms;
+        }
+        printf("%-8s %12ld %12ld %12.2f %12.2f\n", names[a], seek[0], seek[1], ms[0], ms[1]);
+    }
+    sched.quiet = 0;
+    sched.order = NULL;
+    sched.end = NULL;
+
+    // Completion accounting for the last (SATF) merged run
+    merge_expand(&m, order, completed);
+    printf("\nSATF completion order (original requests):");
+    for (int i = 0; i < n; i++) printf(" R%d", completed[i]);
+    printf("\n");
+    merge_free(&m);
 
     return 0;
-}
\ No newline at end of file
+}
+/*
+gcc -O2 scan_sstf_clook.c -o scan_sstf_clook -lm
+./scan_sstf_clook
+./scan_sstf_clook bench 10000000
+*/
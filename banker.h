@@ -0,0 +1,476 @@
+/*
+ * banker.h
+ *
+ * Banker's Algorithm: matrix layout, safety algorithms and an online
+ * resource-request service (admission controller) built on them.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "banker.h"
+ *   gcc -O2 -march=native prog.c -o prog
+ *
+ * Layout:
+ *   Each matrix is one contiguous row-major block. Rows are padded with
+ *   zeros to a multiple of VEC_INTS ints (one 64-byte cache line), so the
+ *   "need <= work" test and the "work += alloc" update run over whole
+ *   vectors with no tail loop. Padding is zero in need, alloc and work,
+ *   so it never changes a comparison. Element (i, j) is m[i * stride + j].
+ *
+ * Safety algorithms:
+ *   safety()        the textbook loop: sweep all processes until a sweep
+ *                   finds nothing, O(n^2 * m) in the worst case.
+ *   safety_sorted() each resource keeps the processes sorted by their
+ *                   need of it (radix sort), plus a cursor past the ones
+ *                   that fit in work. blocked[i] counts the resources P_i
+ *                   still waits for. When work grows the cursors only move
+ *                   forward, and a process is ready the moment its count
+ *                   drops to zero: O(n * m) in total.
+ */
+
+#ifndef BANKER_H
+#define BANKER_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ----------------------------------------------------------------
+// 1. Flat matrices and vector row operations
+// ----------------------------------------------------------------
+#define VEC_INTS 16   // ints per 64-byte cache line
+
+// Row length in ints, rounded up so every row starts on a cache line
+int row_stride(int m) {
+    return (m + VEC_INTS - 1) / VEC_INTS * VEC_INTS;
+}
+
+// One zeroed, cache-line-aligned n x stride matrix
+int *matrix_alloc(int n, int stride) {
+    size_t bytes = (size_t) n * stride * sizeof(int);
+    int *a = aligned_alloc(64, bytes);
+    if (!a) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    memset(a, 0, bytes);
+    return a;
+}
+
+// Is need[0..stride) <= work[0..stride) element-wise?
+int row_fits(const int *need, const int *work, int stride) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i gt = _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i *)(need + j)),
+                                        _mm256_load_si256((const __m256i *)(work + j)));
+        if (!_mm256_testz_si256(gt, gt)) return 0;
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i gt = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)(need + j)),
+                                     _mm_load_si128((const __m128i *)(work + j)));
+        if (_mm_movemask_epi8(gt)) return 0;
+    }
+#else
+    for (int j = 0; j < stride; ++j) {
+        if (need[j] > work[j]) return 0;
+    }
+#endif
+    return 1;
+}
+
+// work[0..stride) += alloc[0..stride)
+void row_add(int *work, const int *alloc, int stride) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i w = _mm256_load_si256((const __m256i *)(work + j));
+        __m256i a = _mm256_load_si256((const __m256i *)(alloc + j));
+        _mm256_store_si256((__m256i *)(work + j), _mm256_add_epi32(w, a));
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i w = _mm_load_si128((const __m128i *)(work + j));
+        __m128i a = _mm_load_si128((const __m128i *)(alloc + j));
+        _mm_store_si128((__m128i *)(work + j), _mm_add_epi32(w, a));
+    }
+#else
+    for (int j = 0; j < stride; ++j) work[j] += alloc[j];
+#endif
+}
+
+// work[0..stride) -= req[0..stride)
+void row_sub(int *work, const int *req, int stride) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i w = _mm256_load_si256((const __m256i *)(work + j));
+        __m256i r = _mm256_load_si256((const __m256i *)(req + j));
+        _mm256_store_si256((__m256i *)(work + j), _mm256_sub_epi32(w, r));
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i w = _mm_load_si128((const __m128i *)(work + j));
+        __m128i r = _mm_load_si128((const __m128i *)(req + j));
+        _mm_store_si128((__m128i *)(work + j), _mm_sub_epi32(w, r));
+    }
+#else
+    for (int j = 0; j < stride; ++j) work[j] -= req[j];
+#endif
+}
+
+// ----------------------------------------------------------------
+// 2. Safety algorithms
+// ----------------------------------------------------------------
+// Safety algorithm. Fills safe_seq and returns how many processes could
+// finish (n means SAFE). work must be a stride-long aligned scratch row.
+int safety(int n, int stride, const int *alloc, const int *need, const int *avail,
+           int *work, int *finish, int *safe_seq) {
+    memcpy(work, avail, stride * sizeof(int));
+    memset(finish, 0, n * sizeof(int));
+
+    int count = 0;
+    while (count < n) {
+        int found = 0;
+        for (int i = 0; i < n; ++i) {
+            if (finish[i]) continue;
+            if (row_fits(need + (size_t) i * stride, work, stride)) {
+                // P_i can be satisfied
+                row_add(work, alloc + (size_t) i * stride, stride);
+                safe_seq[count++] = i;
+                finish[i] = 1;
+                found = 1;
+            }
+        }
+        if (!found) break; // no further process can be satisfied
+    }
+    return count;
+}
+
+// Sort idx[0..n) by key[] (stable LSD radix, 8 bits per pass), leaving the
+// sorted keys in key[]. Passes where every key has the same digit are
+// skipped, so small needs cost one or two passes.
+void radix_sort_by_key(unsigned *key, int *idx, unsigned *key_tmp, int *idx_tmp, int n) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        int count[257] = {0};
+        for (int i = 0; i < n; ++i) count[((key[i] >> shift) & 0xff) + 1]++;
+        if (count[((key[0] >> shift) & 0xff) + 1] == n) continue;
+        for (int d = 0; d < 256; ++d) count[d + 1] += count[d];
+        for (int i = 0; i < n; ++i) {
+            int pos = count[(key[i] >> shift) & 0xff]++;
+            key_tmp[pos] = key[i];
+            idx_tmp[pos] = idx[i];
+        }
+        memcpy(key, key_tmp, n * sizeof(unsigned));
+        memcpy(idx, idx_tmp, n * sizeof(int));
+    }
+}
+
+// Sorted-need safety algorithm. Same contract as safety(); safe_seq also
+// serves as the queue of processes that are ready but not yet finished.
+int safety_sorted(int n, int m, int stride, const int *alloc, const int *need,
+                  const int *avail, int *work, int *safe_seq) {
+    // m lists of (need, process) sorted by need; keys are stored biased
+    // (sign bit flipped) so that unsigned order matches signed order
+    unsigned *key = malloc((size_t) n * m * sizeof(unsigned));
+    int *by_need = malloc((size_t) n * m * sizeof(int));
+    unsigned *key_tmp = malloc(n * sizeof(unsigned));
+    int *idx_tmp = malloc(n * sizeof(int));
+    int *cursor = calloc(m, sizeof(int));
+    int *blocked = malloc(n * sizeof(int));
+
+    for (int j = 0; j < m; ++j) {
+        unsigned *k = key + (size_t) j * n;
+        int *list = by_need + (size_t) j * n;
+        for (int i = 0; i < n; ++i) {
+            k[i] = (unsigned) need[(size_t) i * stride + j] ^ 0x80000000u;
+            list[i] = i;
+        }
+        radix_sort_by_key(k, list, key_tmp, idx_tmp, n);
+    }
+    for (int i = 0; i < n; ++i) blocked[i] = m;
+    memcpy(work, avail, stride * sizeof(int));
+
+    int head = 0, tail = 0;
+    for (;;) {
+        // Release every process whose need of resource j now fits
+        for (int j = 0; j < m; ++j) {
+            const unsigned *k = key + (size_t) j * n;
+            const int *list = by_need + (size_t) j * n;
+            unsigned limit = (unsigned) work[j] ^ 0x80000000u;
+            while (cursor[j] < n && k[cursor[j]] <= limit) {
+                if (--blocked[list[cursor[j]]] == 0) safe_seq[tail++] = list[cursor[j]];
+                cursor[j]++;
+            }
+        }
+        if (head == tail) break; // nobody ready
+        // P_i can be satisfied
+        int i = safe_seq[head++];
+        row_add(work, alloc + (size_t) i * stride, stride);
+    }
+
+    free(key); free(by_need); free(key_tmp); free(idx_tmp);
+    free(cursor); free(blocked);
+    return tail;
+}
+
+// Replay a safe sequence from avail: every process must appear once and
+// its need must fit in work at its turn
+int verify_safe_sequence(int n, int stride, const int *alloc, const int *need,
+                         const int *avail, int *work, const int *seq) {
+    int *seen = calloc(n, sizeof(int));
+    int ok = 1;
+    memcpy(work, avail, stride * sizeof(int));
+    for (int k = 0; k < n && ok; ++k) {
+        int i = seq[k];
+        if (i < 0 || i >= n || seen[i] || !row_fits(need + (size_t) i * stride, work, stride)) {
+            ok = 0;
+        } else {
+            seen[i] = 1;
+            row_add(work, alloc + (size_t) i * stride, stride);
+        }
+    }
+    free(seen);
+    return ok;
+}
+
+
+// ----------------------------------------------------------------
+// 3. Online service: request / release / add / remove
+// ----------------------------------------------------------------
+// The state is kept safe at all times, together with one safe sequence
+// for it (seq[0..n), pos[pid] = index in seq). Most changes provably keep
+// that sequence valid, so the safety check is incremental:
+//
+//  - release(p, r): work at P_p's turn grows by r and so does P_p's need;
+//    everybody else sees the same or more work. Sequence still valid.
+//  - remove(p):     P_p's allocation goes back to avail. Processes before
+//    it see more work, processes after it the same. Still valid.
+//  - add(p):        appended at the end, where work is every instance in
+//    the system. Valid as long as its claim is within the totals.
+//  - request(p, r): only processes before P_p in seq see r less work
+//    (P_p's need drops by r too, later ones see the same work). So only
+//    that prefix is re-checked. If it fails at position k, seq[0..k) is
+//    kept and the rest is re-ordered by sweeping it in its old order
+//    (banker_repair), which rarely takes more than a sweep or two.
+//
+// Process ids are row slots. Slots of removed processes are reused; a
+// free slot has all-zero rows, so it is harmless to the full check.
+
+enum {
+    BANKER_GRANTED = 0,   // allocated, state still safe
+    BANKER_WAIT,          // not enough available right now
+    BANKER_UNSAFE,        // available, but granting would be unsafe
+    BANKER_INVALID        // exceeds the declared claim / unknown process
+};
+
+typedef struct {
+    int m, stride;
+    int capacity;         // process slots (rows) allocated
+    int n;                // live processes
+    int *alloc, *max, *need;   // capacity x stride
+    int *avail, *total;        // 1 x stride
+    int *live;            // live[pid] != 0 if the slot is in use
+    int *seq, *pos;       // current safe sequence and its inverse
+    int *work, *row;      // scratch rows
+    int *tmp_seq;         // scratch for full checks (capacity)
+    int incremental;      // 0 = always run the full check (for comparison)
+    long prefix_checks;   // requests settled by the prefix re-check
+    long slow_checks;     // requests that needed a repair or a full check
+} banker_t;
+
+const char *banker_result_name(int r) {
+    static const char *names[] = {"granted", "wait", "unsafe", "invalid"};
+    return (r >= 0 && r <= BANKER_INVALID) ? names[r] : "?";
+}
+
+// Copy an m-long caller vector into the padded scratch row
+int *banker_row(banker_t *b, const int *v) {
+    memcpy(b->row, v, b->m * sizeof(int));
+    return b->row;
+}
+
+void banker_init(banker_t *b, int m, const int *total) {
+    memset(b, 0, sizeof(*b));
+    b->m = m;
+    b->stride = row_stride(m);
+    b->avail = matrix_alloc(1, b->stride);
+    b->total = matrix_alloc(1, b->stride);
+    b->work = matrix_alloc(1, b->stride);
+    b->row = matrix_alloc(1, b->stride);
+    memcpy(b->avail, total, m * sizeof(int));
+    memcpy(b->total, total, m * sizeof(int));
+    b->incremental = 1;
+}
+
+void banker_free(banker_t *b) {
+    free(b->alloc); free(b->max); free(b->need);
+    free(b->avail); free(b->total); free(b->work); free(b->row);
+    free(b->live); free(b->seq); free(b->pos); free(b->tmp_seq);
+}
+
+// Double the number of process slots
+void banker_grow(banker_t *b) {
+    int old = b->capacity;
+    int cap = old ? 2 * old : 16;
+    int **mats[] = {&b->alloc, &b->max, &b->need};
+    for (int k = 0; k < 3; ++k) {
+        int *a = matrix_alloc(cap, b->stride);
+        if (old) memcpy(a, *mats[k], (size_t) old * b->stride * sizeof(int));
+        free(*mats[k]);
+        *mats[k] = a;
+    }
+    b->live = realloc(b->live, cap * sizeof(int));
+    b->seq = realloc(b->seq, cap * sizeof(int));
+    b->pos = realloc(b->pos, cap * sizeof(int));
+    b->tmp_seq = realloc(b->tmp_seq, cap * sizeof(int));
+    memset(b->live + old, 0, (cap - old) * sizeof(int));
+    b->capacity = cap;
+}
+
+// Register a process with its maximum claim. Returns its id, or -1 if
+// the claim exceeds the total instances of some resource.
+int banker_add(banker_t *b, const int *max) {
+    if (!row_fits(banker_row(b, max), b->total, b->stride)) return -1;
+    int pid = 0;
+    while (pid < b->capacity && b->live[pid]) pid++;
+    if (pid == b->capacity) banker_grow(b);
+
+    int *row = b->max + (size_t) pid * b->stride;
+    memcpy(row, b->row, b->stride * sizeof(int));
+    memcpy(b->need + (size_t) pid * b->stride, b->row, b->stride * sizeof(int));
+    b->live[pid] = 1;
+    b->pos[pid] = b->n;
+    b->seq[b->n++] = pid;
+    return pid;
+}
+
+// Process exit: everything it holds goes back to avail
+int banker_remove(banker_t *b, int pid) {
+    if (pid < 0 || pid >= b->capacity || !b->live[pid]) return BANKER_INVALID;
+    size_t r = (size_t) pid * b->stride;
+    row_add(b->avail, b->alloc + r, b->stride);
+    memset(b->alloc + r, 0, b->stride * sizeof(int));
+    memset(b->max + r, 0, b->stride * sizeof(int));
+    memset(b->need + r, 0, b->stride * sizeof(int));
+    b->live[pid] = 0;
+
+    for (int k = b->pos[pid]; k < b->n - 1; ++k) {
+        b->seq[k] = b->seq[k + 1];
+        b->pos[b->seq[k]] = k;
+    }
+    b->n--;
+    return BANKER_GRANTED;
+}
+
+// Give back part of an allocation (rel <= alloc)
+int banker_release(banker_t *b, int pid, const int *rel) {
+    if (pid < 0 || pid >= b->capacity || !b->live[pid]) return BANKER_INVALID;
+    size_t r = (size_t) pid * b->stride;
+    int *v = banker_row(b, rel);
+    if (!row_fits(v, b->alloc + r, b->stride)) return BANKER_INVALID;
+    row_sub(b->alloc + r, v, b->stride);
+    row_add(b->need + r, v, b->stride);
+    row_add(b->avail, v, b->stride);
+    return BANKER_GRANTED;
+}
+
+// Where does the current seq stop being safe? Walks seq from avail and
+// returns the first position whose need no longer fits (limit if none),
+// leaving the work vector at that point in b->work.
+int banker_valid_prefix(banker_t *b, int limit) {
+    memcpy(b->work, b->avail, b->stride * sizeof(int));
+    for (int k = 0; k < limit; ++k) {
+        size_t r = (size_t) b->seq[k] * b->stride;
+        if (!row_fits(b->need + r, b->work, b->stride)) return k;
+        row_add(b->work, b->alloc + r, b->stride);
+    }
+    return limit;
+}
+
+// Repair seq from position k on (b->work = work after seq[0..k)): sweep
+// the rest in their old order, taking whoever fits and keeping the
+// others for the next sweep. The old order is nearly right, so this is
+// usually one or two sweeps. Returns 0 if some process can never finish.
+int banker_repair(banker_t *b, int k) {
+    int *rest = b->tmp_seq;
+    int nrest = b->n - k;
+    memcpy(rest, b->seq + k, nrest * sizeof(int));
+
+    int done = k;
+    int progress = 1;
+    while (nrest > 0 && progress) {
+        progress = 0;
+        int left = 0;
+        for (int s = 0; s < nrest; ++s) {
+            size_t r = (size_t) rest[s] * b->stride;
+            if (row_fits(b->need + r, b->work, b->stride)) {
+                row_add(b->work, b->alloc + r, b->stride);
+                b->seq[done++] = rest[s];
+                progress = 1;
+            } else {
+                rest[left++] = rest[s];
+            }
+        }
+        nrest = left;
+    }
+    // Keep seq a permutation either way; pos follows it
+    memcpy(b->seq + done, rest, nrest * sizeof(int));
+    for (int s = k; s < b->n; ++s) b->pos[b->seq[s]] = s;
+    return nrest == 0;
+}
+
+// Full check over every slot; on success adopt the new sequence
+int banker_full_safe(banker_t *b) {
+    int count = safety_sorted(b->capacity, b->m, b->stride, b->alloc, b->need,
+                              b->avail, b->work, b->tmp_seq);
+    if (count < b->capacity) return 0;
+    int k = 0;
+    for (int s = 0; s < count; ++s) {
+        int pid = b->tmp_seq[s];
+        if (!b->live[pid]) continue;
+        b->seq[k] = pid;
+        b->pos[pid] = k++;
+    }
+    return 1;
+}
+
+// Resource-request algorithm
+int banker_request(banker_t *b, int pid, const int *req) {
+    if (pid < 0 || pid >= b->capacity || !b->live[pid]) return BANKER_INVALID;
+    size_t r = (size_t) pid * b->stride;
+    int *v = banker_row(b, req);
+    if (!row_fits(v, b->need + r, b->stride)) return BANKER_INVALID;
+    if (!row_fits(v, b->avail, b->stride)) return BANKER_WAIT;
+
+    // Pretend to allocate
+    row_sub(b->avail, v, b->stride);
+    row_add(b->alloc + r, v, b->stride);
+    row_sub(b->need + r, v, b->stride);
+
+    int safe;
+    if (b->incremental) {
+        int k = banker_valid_prefix(b, b->pos[pid]);
+        if (k == b->pos[pid]) {
+            b->prefix_checks++;
+            return BANKER_GRANTED;
+        }
+        b->slow_checks++;
+        safe = banker_repair(b, k);
+    } else {
+        b->slow_checks++;
+        safe = banker_full_safe(b);
+    }
+    if (safe) return BANKER_GRANTED;
+
+    // Unsafe: roll back (v still holds the request)
+    row_add(b->avail, v, b->stride);
+    row_sub(b->alloc + r, v, b->stride);
+    row_add(b->need + r, v, b->stride);
+    if (b->incremental) {
+        // The failed repair reordered seq, so it may no longer prove the
+        // (safe) rolled-back state; repair it from where it breaks
+        banker_repair(b, banker_valid_prefix(b, b->n));
+    }
+    return BANKER_UNSAFE;
+}
+
+#endif
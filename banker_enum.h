@@ -0,0 +1,419 @@
+/*
+ * banker_enum.h
+ *
+ * Counting (and listing) every safe sequence of a Banker's state, for
+ * what-if analysis: how many orders can the processes finish in, and at
+ * which positions can each of them finish?
+ *
+ * Header-only, on top of banker.h:
+ *   #include "banker_enum.h"
+ *   gcc -O2 -march=native prog.c -o prog -pthread
+ *
+ * The state after some processes have finished depends only on WHICH
+ * ones finished (work = avail + their allocations), not on the order.
+ * So the number of safe completions is a function of the finished set,
+ * a bitmask, and a depth-first search memoizes it per mask:
+ *
+ *   count(all) = 1
+ *   count(S)   = sum of count(S + i) over the P_i not in S with need <= work(S)
+ *
+ * That visits every reachable finished set once instead of every order
+ * (at most 2^n states instead of n! sequences). n is limited to 63.
+ *
+ * Parallel search: the memo is one lock-free hash table shared by all
+ * workers. Near the root (the first 'split' levels) a worker keeps the
+ * first subtree for itself and pushes the others on its own deque; idle
+ * workers steal from the other end of somebody's deque. The owner pops
+ * back whatever is left. A subtree that was stolen but is not finished
+ * yet is just searched again by the owner, which then mostly finds the
+ * thief's finished entries in the memo, so nobody ever waits.
+ *
+ * A run stops early on a state limit (memo size) or a time limit;
+ * e->states is the progress counter.
+ */
+
+#ifndef BANKER_ENUM_H
+#define BANKER_ENUM_H
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "banker.h"
+
+#define ENUM_MAX_PROCS 63
+#define ENUM_MAX_SPLIT 16
+#define ENUM_DEQUE     (ENUM_MAX_PROCS * ENUM_MAX_SPLIT)
+
+enum { ENUM_RUNNING, ENUM_STATE_LIMIT, ENUM_TIME_LIMIT };
+
+// Counts are kept in 96 bits and saturate (63! does not fit, 27! does)
+typedef unsigned __int128 enum_count_t;
+#define ENUM_COUNT_MAX (((enum_count_t) 1 << 96) - 1)
+
+typedef struct {
+    _Atomic uint64_t key;      // finished set + 1, 0 = free slot
+    _Atomic uint32_t state;    // 0 searching, 1 being written, 2 done
+    uint32_t hi;               // count = hi << 64 | lo
+    uint64_t lo;
+} enum_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;      // deque; steals only happen near the root
+    uint64_t task[ENUM_DEQUE];
+    int top, bottom;           // thieves take from top, the owner from bottom
+    int *work;
+    unsigned seed;
+    int earliest[ENUM_MAX_PROCS], latest[ENUM_MAX_PROCS];
+    long steals;
+} enum_worker_t;
+
+typedef struct {
+    int n, m, stride;
+    const int *alloc, *need, *avail;
+    uint64_t all;
+    int split;                 // levels whose subtrees are offered to others
+    enum_entry_t *table;
+    uint64_t mask;
+    long max_states;
+    _Atomic long states;       // progress: finished sets seen so far
+    _Atomic int stop;          // ENUM_RUNNING or why the search stopped
+    _Atomic int done;
+    int threads;
+    enum_worker_t *w;
+
+    // results
+    enum_count_t count;
+    int earliest[ENUM_MAX_PROCS], latest[ENUM_MAX_PROCS];   // -1 = never
+    long steals;
+    double seconds;
+} banker_enum_t;
+
+uint64_t enum_hash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+void banker_enum_init(banker_enum_t *e, int n, int m, int stride, const int *alloc,
+                      const int *need, const int *avail, int threads, long max_states) {
+    memset(e, 0, sizeof(*e));
+    e->n = n;
+    e->m = m;
+    e->stride = stride;
+    e->alloc = alloc;
+    e->need = need;
+    e->avail = avail;
+    e->all = (n == 64) ? ~0ULL : (1ULL << n) - 1;
+    e->split = threads > 1 ? (n < 8 ? n : 8) : 0;
+    e->max_states = max_states;
+    uint64_t size = 1024;
+    while (size < 2 * (uint64_t) max_states) size *= 2;   // at most half full
+    e->table = calloc(size, sizeof(enum_entry_t));
+    if (!e->table) {
+        perror("calloc");
+        exit(1);
+    }
+    e->mask = size - 1;
+    e->threads = threads;
+    e->w = calloc(threads, sizeof(enum_worker_t));
+    for (int t = 0; t < threads; ++t) {
+        pthread_mutex_init(&e->w[t].lock, NULL);
+        e->w[t].work = matrix_alloc(1, stride);
+        e->w[t].seed = t + 1;
+        for (int i = 0; i < n; ++i) {
+            e->w[t].earliest[i] = n;
+            e->w[t].latest[i] = -1;
+        }
+    }
+}
+
+void banker_enum_free(banker_enum_t *e) {
+    for (int t = 0; t < e->threads; ++t) {
+        pthread_mutex_destroy(&e->w[t].lock);
+        free(e->w[t].work);
+    }
+    free(e->w);
+    free(e->table);
+}
+
+// Memo entry of finished set s, created if new; NULL once the state
+// limit is reached
+enum_entry_t *enum_entry(banker_enum_t *e, uint64_t s) {
+    uint64_t key = s + 1;
+    for (uint64_t h = enum_hash(key);; ++h) {
+        enum_entry_t *x = &e->table[h & e->mask];
+        uint64_t k = atomic_load_explicit(&x->key, memory_order_acquire);
+        if (k == key) return x;
+        if (k != 0) continue;
+        if (atomic_load_explicit(&e->states, memory_order_relaxed) >= e->max_states) {
+            atomic_store(&e->stop, ENUM_STATE_LIMIT);
+            return NULL;
+        }
+        if (atomic_compare_exchange_strong(&x->key, &k, key)) {
+            atomic_fetch_add_explicit(&e->states, 1, memory_order_relaxed);
+            return x;
+        }
+        if (k == key) return x;
+    }
+}
+
+enum_count_t enum_value(const enum_entry_t *x) {
+    return (enum_count_t) x->hi << 64 | x->lo;
+}
+
+// Publish a finished count; when two workers searched the same set, the
+// first one writes it
+void enum_store(enum_entry_t *x, enum_count_t v) {
+    uint32_t expect = 0;
+    if (atomic_compare_exchange_strong(&x->state, &expect, 1)) {
+        x->lo = (uint64_t) v;
+        x->hi = (uint32_t) (v >> 64);
+        atomic_store_explicit(&x->state, 2, memory_order_release);
+    }
+}
+
+void enum_push(enum_worker_t *w, uint64_t s) {
+    pthread_mutex_lock(&w->lock);
+    w->task[w->bottom++] = s;
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Take back the newest task above position mark, if no thief got it
+int enum_pop(enum_worker_t *w, int mark, uint64_t *s) {
+    int got = 0;
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom > w->top && w->bottom > mark) {
+        *s = w->task[--w->bottom];
+        got = 1;
+    }
+    if (w->bottom <= w->top) w->top = w->bottom = 0;
+    pthread_mutex_unlock(&w->lock);
+    return got;
+}
+
+// Take the oldest task (the biggest subtree) of some other worker
+int enum_steal(banker_enum_t *e, enum_worker_t *self, uint64_t *s) {
+    int start = rand_r(&self->seed) % e->threads;
+    for (int k = 0; k < e->threads; ++k) {
+        enum_worker_t *v = &e->w[(start + k) % e->threads];
+        if (v == self) continue;
+        pthread_mutex_lock(&v->lock);
+        int got = 0;
+        if (v->top < v->bottom) {
+            *s = v->task[v->top++];
+            got = 1;
+        }
+        pthread_mutex_unlock(&v->lock);
+        if (got) {
+            self->steals++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+enum_count_t enum_count(banker_enum_t *e, enum_worker_t *w, uint64_t s, int *work, int depth);
+
+// count(s + P_i), with work = work(s)
+enum_count_t enum_child(banker_enum_t *e, enum_worker_t *w, uint64_t s, int i, int *work, int depth) {
+    const int *a = e->alloc + (size_t) i * e->stride;
+    row_add(work, a, e->stride);
+    enum_count_t v = enum_count(e, w, s | 1ULL << i, work, depth + 1);
+    row_sub(work, a, e->stride);
+    return v;
+}
+
+// Number of safe completions of finished set s (depth = |s|). work holds
+// work(s) and is restored before returning.
+enum_count_t enum_count(banker_enum_t *e, enum_worker_t *w, uint64_t s, int *work, int depth) {
+    if (atomic_load_explicit(&e->stop, memory_order_relaxed)) return 0;
+    enum_entry_t *x = enum_entry(e, s);
+    if (!x) return 0;
+    if (atomic_load_explicit(&x->state, memory_order_acquire) == 2) return enum_value(x);
+    if (s == e->all) {
+        enum_store(x, 1);
+        return 1;
+    }
+
+    int kids[ENUM_MAX_PROCS], nk = 0;
+    for (int i = 0; i < e->n; ++i) {
+        if (!(s >> i & 1) && row_fits(e->need + (size_t) i * e->stride, work, e->stride))
+            kids[nk++] = i;
+    }
+
+    if (depth < e->split && nk > 1) {
+        // Offer all but the first subtree, search the first, then take
+        // back what nobody stole
+        int mark = w->bottom;
+        for (int k = nk - 1; k >= 1; --k) enum_push(w, s | 1ULL << kids[k]);
+        enum_child(e, w, s, kids[0], work, depth);
+        uint64_t t;
+        while (enum_pop(w, mark, &t)) enum_child(e, w, s, __builtin_ctzll(t ^ s), work, depth);
+    }
+
+    // Every child is done now, unless it was stolen and is still being
+    // searched; then enum_child() searches it too
+    enum_count_t total = 0;
+    for (int k = 0; k < nk; ++k) {
+        enum_count_t v = enum_child(e, w, s, kids[k], work, depth);
+        if (v == 0) continue;
+        total = (v > ENUM_COUNT_MAX - total) ? ENUM_COUNT_MAX : total + v;
+        if (depth < w->earliest[kids[k]]) w->earliest[kids[k]] = depth;
+        if (depth > w->latest[kids[k]]) w->latest[kids[k]] = depth;
+    }
+    if (!atomic_load_explicit(&e->stop, memory_order_relaxed)) enum_store(x, total);
+    return total;
+}
+
+// Search from finished set s with nothing else set up
+enum_count_t enum_start(banker_enum_t *e, enum_worker_t *w, uint64_t s) {
+    memcpy(w->work, e->avail, e->stride * sizeof(int));
+    for (int i = 0; i < e->n; ++i) {
+        if (s >> i & 1) row_add(w->work, e->alloc + (size_t) i * e->stride, e->stride);
+    }
+    return enum_count(e, w, s, w->work, __builtin_popcountll(s));
+}
+
+typedef struct {
+    banker_enum_t *e;
+    int id;
+} enum_arg_t;
+
+void *enum_thread(void *arg) {
+    banker_enum_t *e = ((enum_arg_t *) arg)->e;
+    int id = ((enum_arg_t *) arg)->id;
+    enum_worker_t *w = &e->w[id];
+    if (id == 0) {
+        e->count = enum_start(e, w, 0);
+        atomic_store(&e->done, 1);
+        return NULL;
+    }
+    int idle = 0;
+    while (!atomic_load_explicit(&e->done, memory_order_relaxed) &&
+           !atomic_load_explicit(&e->stop, memory_order_relaxed)) {
+        uint64_t s;
+        if (enum_steal(e, w, &s)) {
+            enum_start(e, w, s);
+            idle = 0;
+        } else if (++idle > 64) {
+            struct timespec nap = { 0, 50000 };
+            nanosleep(&nap, NULL);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+double enum_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Count all safe sequences with e->threads workers. Gives up after
+// timeout seconds (0 = never); with progress set, prints the number of
+// states searched to stderr every second. Returns ENUM_RUNNING if the
+// count is complete, otherwise why it stopped.
+int banker_enum_run(banker_enum_t *e, double timeout, int progress) {
+    if (e->n > ENUM_MAX_PROCS) {
+        fprintf(stderr, "Safe sequence counting supports at most %d processes\n", ENUM_MAX_PROCS);
+        exit(1);
+    }
+    pthread_t *tid = malloc(e->threads * sizeof(pthread_t));
+    enum_arg_t *args = malloc(e->threads * sizeof(enum_arg_t));
+    double t0 = enum_now(), next_report = t0 + 1;
+    for (int t = 0; t < e->threads; ++t) {
+        args[t] = (enum_arg_t){ e, t };
+        if (pthread_create(&tid[t], NULL, enum_thread, &args[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    // Watch the clock until the root is done
+    while (!atomic_load(&e->done) && !atomic_load(&e->stop)) {
+        struct timespec nap = { 0, 1000000 };
+        nanosleep(&nap, NULL);
+        double now = enum_now();
+        if (timeout > 0 && now - t0 >= timeout) atomic_store(&e->stop, ENUM_TIME_LIMIT);
+        if (progress && now >= next_report) {
+            long states = atomic_load(&e->states);
+            fprintf(stderr, "\r%ld states searched (%.0f/s)", states, states / (now - t0));
+            next_report += 1;
+        }
+    }
+    for (int t = 0; t < e->threads; ++t) pthread_join(tid[t], NULL);
+    e->seconds = enum_now() - t0;
+    if (progress && e->seconds >= 1) fprintf(stderr, "\n");
+
+    for (int i = 0; i < e->n; ++i) {
+        e->earliest[i] = e->n;
+        e->latest[i] = -1;
+        for (int t = 0; t < e->threads; ++t) {
+            if (e->w[t].earliest[i] < e->earliest[i]) e->earliest[i] = e->w[t].earliest[i];
+            if (e->w[t].latest[i] > e->latest[i]) e->latest[i] = e->w[t].latest[i];
+        }
+        if (e->latest[i] < 0) e->earliest[i] = -1;
+    }
+    for (int t = 0; t < e->threads; ++t) e->steals += e->w[t].steals;
+    free(tid); free(args);
+    return atomic_load(&e->stop);
+}
+
+// Finished count of set s from a completed run (0 if it was never reached)
+enum_count_t enum_lookup(const banker_enum_t *e, uint64_t s) {
+    uint64_t key = s + 1;
+    for (uint64_t h = enum_hash(key);; ++h) {
+        const enum_entry_t *x = &e->table[h & e->mask];
+        uint64_t k = atomic_load_explicit(&x->key, memory_order_relaxed);
+        if (k == 0) return 0;
+        if (k == key) return atomic_load_explicit(&x->state, memory_order_acquire) == 2 ? enum_value(x) : 0;
+    }
+}
+
+// Hand up to *limit safe sequences to visit(), in lexicographic order,
+// following the counts of a completed run (no dead ends)
+void enum_list(const banker_enum_t *e, uint64_t s, int *work, int *seq, int depth, long *limit,
+               void (*visit)(const int *seq, int n)) {
+    if (depth == e->n) {
+        visit(seq, e->n);
+        --*limit;
+        return;
+    }
+    for (int i = 0; i < e->n && *limit > 0; ++i) {
+        if ((s >> i & 1) || !row_fits(e->need + (size_t) i * e->stride, work, e->stride)) continue;
+        if (enum_lookup(e, s | 1ULL << i) == 0) continue;
+        const int *a = e->alloc + (size_t) i * e->stride;
+        seq[depth] = i;
+        row_add(work, a, e->stride);
+        enum_list(e, s | 1ULL << i, work, seq, depth + 1, limit, visit);
+        row_sub(work, a, e->stride);
+    }
+}
+
+void banker_enum_list(const banker_enum_t *e, long limit, void (*visit)(const int *seq, int n)) {
+    int *work = matrix_alloc(1, e->stride);
+    int *seq = malloc(e->n * sizeof(int));
+    memcpy(work, e->avail, e->stride * sizeof(int));
+    enum_list(e, 0, work, seq, 0, &limit, visit);
+    free(work); free(seq);
+}
+
+// Decimal digits of v into buf (at least 40 bytes)
+char *enum_count_str(enum_count_t v, char *buf) {
+    char tmp[40];
+    int k = 0;
+    do {
+        tmp[k++] = '0' + (int) (v % 10);
+        v /= 10;
+    } while (v);
+    for (int i = 0; i < k; ++i) buf[i] = tmp[k - 1 - i];
+    buf[k] = '\0';
+    return buf;
+}
+
+#endif
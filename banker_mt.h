@@ -0,0 +1,361 @@
+/*
+ * banker_mt.h
+ *
+ * Thread-safe Banker's resource manager for many pthreads at once.
+ *
+ * Header-only, on top of banker.h:
+ *   #include "banker_mt.h"
+ *   gcc -O2 -march=native prog.c -o prog -pthread
+ *
+ * Every call (add, remove, request, release) is a small record on the
+ * caller's stack. If the combiner lock is free the caller takes it and
+ * runs the call itself; otherwise the record is pushed on a lock-free
+ * list, and whoever holds the lock takes the whole list as one batch:
+ *
+ *  1. adds, removes and releases are applied first; none of them needs a
+ *     safety check (see banker.h).
+ *  2. every new request (and, after a release, every parked one) that
+ *     fits in avail is applied tentatively, and ONE safety evaluation
+ *     covers the whole batch.
+ *  3. if the batch as a whole is unsafe, it is rolled back and the
+ *     requests go through banker_request() one at a time instead.
+ *
+ * Requests that cannot be granted yet are parked inside the manager and
+ * retried after the next release. Each caller waits on the futex word in
+ * its own record (spin, then yield, then sleep), so a grant wakes exactly
+ * that thread. banker_mt_request() therefore blocks until the request is
+ * granted, or returns BANKER_INVALID at once.
+ *
+ * banker_locked_t is the obvious alternative for comparison: one global
+ * mutex around banker_t, and a condition variable broadcast on every
+ * release.
+ */
+
+#ifndef BANKER_MT_H
+#define BANKER_MT_H
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "banker.h"
+
+#define BANKER_MT_SPIN 200   // polls before sleeping on the futex (SMP only)
+#define BANKER_MT_YIELD  8   // then yields, so a preempted combiner can finish
+
+enum { BANKER_OP_ADD, BANKER_OP_REMOVE, BANKER_OP_REQUEST, BANKER_OP_RELEASE };
+
+// One published call; lives on the caller's stack until it completes
+typedef struct banker_op {
+    struct banker_op *next;
+    int op;
+    int pid;
+    const int *vec;       // m values (max, request or release)
+    int result;
+    int applied;          // tentatively applied in the current batch
+    _Atomic int pending;  // futex word: 0 done, 1 pending, 2 pending + asleep
+} banker_op_t;
+
+typedef struct {
+    banker_t b;
+    _Atomic(banker_op_t *) published;  // new calls, newest first
+    atomic_flag combining;
+    banker_op_t *parked;               // requests not granted yet (combiner only)
+    int spin;                          // polls before sleeping; 0 on one CPU
+    // statistics (combiner only)
+    long batches, batched_requests, batch_safe, batch_fallbacks;
+} banker_mt_t;
+
+long futex(_Atomic int *addr, int op, int val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+void banker_mt_init(banker_mt_t *mt, int m, const int *total) {
+    banker_init(&mt->b, m, total);
+    atomic_init(&mt->published, NULL);
+    atomic_flag_clear(&mt->combining);
+    mt->parked = NULL;
+    mt->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? BANKER_MT_SPIN : 0;
+    mt->batches = mt->batched_requests = mt->batch_safe = mt->batch_fallbacks = 0;
+}
+
+void banker_mt_destroy(banker_mt_t *mt) {
+    banker_free(&mt->b);
+}
+
+// Hand the result back and wake the caller if it went to sleep. The
+// record may vanish as soon as pending drops, so only its address is
+// used after that (a stray wake-up is harmless, waiters re-check).
+void banker_op_complete(banker_op_t *o, int result) {
+    o->result = result;
+    if (atomic_exchange_explicit(&o->pending, 0, memory_order_acq_rel) == 2)
+        futex(&o->pending, FUTEX_WAKE_PRIVATE, 1);
+}
+
+// Tentatively apply / undo a request (the caller checked it fits)
+void banker_apply(banker_t *b, const banker_op_t *o, int sign) {
+    size_t r = (size_t) o->pid * b->stride;
+    int *v = banker_row(b, o->vec);
+    if (sign > 0) {
+        row_sub(b->avail, v, b->stride);
+        row_add(b->alloc + r, v, b->stride);
+        row_sub(b->need + r, v, b->stride);
+    } else {
+        row_add(b->avail, v, b->stride);
+        row_sub(b->alloc + r, v, b->stride);
+        row_add(b->need + r, v, b->stride);
+    }
+}
+
+// Admit a list of requests (in order); returns the ones not granted
+banker_op_t *banker_mt_admit(banker_mt_t *mt, banker_op_t *reqs) {
+    banker_t *b = &mt->b;
+
+    // Apply every request that is valid and fits what is left of avail
+    int applied = 0;
+    int last = 0;         // seq position of the last requester applied
+    banker_op_t **link = &reqs;
+    while (*link) {
+        banker_op_t *o = *link;
+        o->applied = 0;
+        if (o->pid < 0 || o->pid >= b->capacity || !b->live[o->pid] ||
+            !row_fits(banker_row(b, o->vec), b->need + (size_t) o->pid * b->stride, b->stride)) {
+            *link = o->next;
+            banker_op_complete(o, BANKER_INVALID);
+            continue;
+        }
+        if (row_fits(b->row, b->avail, b->stride)) {
+            banker_apply(b, o, +1);
+            o->applied = 1;
+            applied++;
+            if (b->pos[o->pid] > last) last = b->pos[o->pid];
+        }
+        link = &o->next;
+    }
+    mt->batched_requests += applied;
+    if (applied == 0) return reqs;
+
+    // One safety evaluation for the whole batch. Past the last requester
+    // in seq everybody sees the same work as before, and the last one
+    // itself gets back exactly what it asked for, so only the part of seq
+    // before it needs checking (cf. banker_request()).
+    int k = banker_valid_prefix(b, last);
+    if (k == last || banker_repair(b, k)) {
+        mt->batch_safe++;
+        link = &reqs;
+        while (*link) {
+            banker_op_t *o = *link;
+            if (o->applied) {
+                *link = o->next;
+                banker_op_complete(o, BANKER_GRANTED);
+            } else {
+                link = &o->next;
+            }
+        }
+        return reqs;
+    }
+
+    // Unsafe together: roll back, then admit them one at a time
+    mt->batch_fallbacks++;
+    for (banker_op_t *o = reqs; o; o = o->next) {
+        if (o->applied) banker_apply(b, o, -1);
+    }
+    banker_repair(b, banker_valid_prefix(b, b->n));
+    link = &reqs;
+    while (*link) {
+        banker_op_t *o = *link;
+        if (banker_request(b, o->pid, o->vec) == BANKER_GRANTED) {
+            *link = o->next;
+            banker_op_complete(o, BANKER_GRANTED);
+        } else {
+            link = &o->next;
+        }
+    }
+    return reqs;
+}
+
+// Run one batch: everything published so far, the combiner's own call
+// (own, may be NULL) and, if anything was given back, the parked requests.
+//
+// A grant never makes a refused request grantable: if S + r is unsafe,
+// S + g + r is too (any safe sequence for it also works for S + r). So
+// parked requests are only retried after a release or a remove, and a
+// refused request stays refused for the rest of the batch. That also
+// means the manager never parks every process: the first process of the
+// safe sequence after the batch could have been granted in it.
+void banker_mt_combine(banker_mt_t *mt, banker_op_t *own) {
+    banker_t *b = &mt->b;
+    banker_op_t *list = NULL;
+    if (atomic_load_explicit(&mt->published, memory_order_relaxed))
+        list = atomic_exchange_explicit(&mt->published, NULL, memory_order_acquire);
+
+    // Reverse into arrival order, own call last
+    banker_op_t *fifo = own;
+    if (own) own->next = NULL;
+    while (list) {
+        banker_op_t *o = list;
+        list = o->next;
+        o->next = fifo;
+        fifo = o;
+    }
+
+    // Non-requests are applied right away
+    banker_op_t *reqs = NULL, **tail = &reqs;
+    int released = 0;
+    while (fifo) {
+        banker_op_t *o = fifo;
+        fifo = o->next;
+        if (o->op == BANKER_OP_REQUEST) {
+            *tail = o;
+            tail = &o->next;
+        } else if (o->op == BANKER_OP_ADD) {
+            banker_op_complete(o, banker_add(b, o->vec));
+        } else {
+            int r = (o->op == BANKER_OP_REMOVE) ? banker_remove(b, o->pid)
+                                                : banker_release(b, o->pid, o->vec);
+            released |= (r == BANKER_GRANTED);
+            banker_op_complete(o, r);
+        }
+    }
+    *tail = NULL;
+
+    // Parked requests go first, so nobody is overtaken forever
+    banker_op_t *parked = NULL;
+    if (released) {
+        tail = &mt->parked;
+        while (*tail) tail = &(*tail)->next;
+        *tail = reqs;
+        reqs = mt->parked;
+    } else {
+        parked = mt->parked;
+    }
+    mt->parked = NULL;
+    if (reqs) {
+        mt->batches++;
+        reqs = banker_mt_admit(mt, reqs);
+    }
+
+    // Whatever is left waits for the next release
+    tail = &parked;
+    while (*tail) tail = &(*tail)->next;
+    *tail = reqs;
+    mt->parked = parked;
+}
+
+// Publish a call, combine if nobody else is, then wait for the result
+int banker_mt_submit(banker_mt_t *mt, int op, int pid, const int *vec) {
+    banker_op_t o;
+    o.op = op;
+    o.pid = pid;
+    o.vec = vec;
+    atomic_init(&o.pending, 1);
+
+    if (!atomic_flag_test_and_set(&mt->combining)) {
+        // Nobody is combining: no need to publish, just run the batch
+        banker_mt_combine(mt, &o);
+        atomic_flag_clear(&mt->combining);
+    } else {
+        o.next = atomic_load_explicit(&mt->published, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&mt->published, &o.next, &o,
+                                                      memory_order_release, memory_order_relaxed))
+            ;
+    }
+
+    // Keep combining while there is work and the lock is free. The check
+    // after unlocking catches calls published while we held the lock.
+    while (atomic_load(&mt->published) && !atomic_flag_test_and_set(&mt->combining)) {
+        banker_mt_combine(mt, NULL);
+        atomic_flag_clear(&mt->combining);
+    }
+
+    for (int spin = 0; atomic_load_explicit(&o.pending, memory_order_acquire); ++spin) {
+        if (spin < mt->spin) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else if (spin < mt->spin + BANKER_MT_YIELD) {
+            sched_yield();
+        } else {
+            // Announce the sleep so the combiner knows to wake us
+            int expected = 1;
+            if (atomic_compare_exchange_strong(&o.pending, &expected, 2) || expected == 2)
+                futex(&o.pending, FUTEX_WAIT_PRIVATE, 2);
+        }
+    }
+    return o.result;
+}
+
+// Register a process; returns its id or -1 (claim exceeds totals)
+int banker_mt_add(banker_mt_t *mt, const int *max) {
+    return banker_mt_submit(mt, BANKER_OP_ADD, -1, max);
+}
+
+int banker_mt_remove(banker_mt_t *mt, int pid) {
+    return banker_mt_submit(mt, BANKER_OP_REMOVE, pid, NULL);
+}
+
+// Blocks until granted; BANKER_INVALID if it exceeds the claim
+int banker_mt_request(banker_mt_t *mt, int pid, const int *req) {
+    return banker_mt_submit(mt, BANKER_OP_REQUEST, pid, req);
+}
+
+int banker_mt_release(banker_mt_t *mt, int pid, const int *rel) {
+    return banker_mt_submit(mt, BANKER_OP_RELEASE, pid, rel);
+}
+
+// ----------------------------------------------------------------
+// Baseline: one global mutex
+// ----------------------------------------------------------------
+typedef struct {
+    banker_t b;
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+} banker_locked_t;
+
+void banker_locked_init(banker_locked_t *l, int m, const int *total) {
+    banker_init(&l->b, m, total);
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->released, NULL);
+}
+
+void banker_locked_destroy(banker_locked_t *l) {
+    banker_free(&l->b);
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->released);
+}
+
+int banker_locked_add(banker_locked_t *l, const int *max) {
+    pthread_mutex_lock(&l->lock);
+    int pid = banker_add(&l->b, max);
+    pthread_mutex_unlock(&l->lock);
+    return pid;
+}
+
+int banker_locked_remove(banker_locked_t *l, int pid) {
+    pthread_mutex_lock(&l->lock);
+    int r = banker_remove(&l->b, pid);
+    pthread_cond_broadcast(&l->released);
+    pthread_mutex_unlock(&l->lock);
+    return r;
+}
+
+int banker_locked_request(banker_locked_t *l, int pid, const int *req) {
+    pthread_mutex_lock(&l->lock);
+    int r;
+    while ((r = banker_request(&l->b, pid, req)) == BANKER_WAIT || r == BANKER_UNSAFE)
+        pthread_cond_wait(&l->released, &l->lock);
+    pthread_mutex_unlock(&l->lock);
+    return r;
+}
+
+int banker_locked_release(banker_locked_t *l, int pid, const int *rel) {
+    pthread_mutex_lock(&l->lock);
+    int r = banker_release(&l->b, pid, rel);
+    pthread_cond_broadcast(&l->released);
+    pthread_mutex_unlock(&l->lock);
+    return r;
+}
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * banker_mt_bench.c
+ *
+ * Grant throughput of the thread-safe Banker's managers in banker_mt.h
+ * as the number of threads grows.
+ *
+ * Compile:
+ *   gcc -O2 -march=native -o banker_mt_bench banker_mt_bench.c -pthread
+ *
+ * Run:
+ *   ./banker_mt_bench [max_threads] [requests_per_thread] [resources]
+ *
+ * Every thread is one Banker's process with a claim of CLAIM units of
+ * each resource. It asks for a unit of two random resources at a time,
+ * and gives back everything it holds after every HOLD grants. There are
+ * only 2 * threads + CLAIM units of each resource, so not every thread
+ * can reach its claim at once and the safety check really decides.
+ *
+ * Output:
+ *   For 1, 2, 4, ... max_threads threads: grants per second with the
+ *   combining manager and with one global mutex, plus the combiner's
+ *   average batch size and how often a batch had to fall back to one
+ *   request at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "banker_mt.h"
+
+#define CLAIM 4
+#define HOLD  4
+
+typedef struct {
+    int combining;            // 1 = banker_mt_t, 0 = banker_locked_t
+    banker_mt_t *mt;
+    banker_locked_t *locked;
+    int m;
+    int requests;
+    unsigned seed;
+} worker_t;
+
+void *worker(void *arg) {
+    worker_t *w = arg;
+    int *claim = malloc(w->m * sizeof(int));
+    int *req = malloc(w->m * sizeof(int));
+    int *held = calloc(w->m, sizeof(int));
+    for (int j = 0; j < w->m; ++j) claim[j] = CLAIM;
+
+    int pid = w->combining ? banker_mt_add(w->mt, claim) : banker_locked_add(w->locked, claim);
+    for (int i = 0; i < w->requests; ++i) {
+        memset(req, 0, w->m * sizeof(int));
+        for (int k = 0; k < 2; ++k) {
+            int j = rand_r(&w->seed) % w->m;
+            if (held[j] + req[j] < CLAIM) req[j]++;
+        }
+        int r = w->combining ? banker_mt_request(w->mt, pid, req)
+                             : banker_locked_request(w->locked, pid, req);
+        if (r != BANKER_GRANTED) {
+            fprintf(stderr, "P%d: request %s\n", pid, banker_result_name(r));
+            exit(1);
+        }
+        for (int j = 0; j < w->m; ++j) held[j] += req[j];
+
+        if (i % HOLD == HOLD - 1) {
+            if (w->combining) banker_mt_release(w->mt, pid, held);
+            else banker_locked_release(w->locked, pid, held);
+            memset(held, 0, w->m * sizeof(int));
+        }
+    }
+    if (w->combining) banker_mt_remove(w->mt, pid);
+    else banker_locked_remove(w->locked, pid);
+
+    free(claim); free(req); free(held);
+    return NULL;
+}
+
+// Grants per second with 'threads' threads
+double run(int combining, int threads, int requests, int m, banker_mt_t *stats) {
+    int *total = malloc(m * sizeof(int));
+    for (int j = 0; j < m; ++j) total[j] = 2 * threads + CLAIM;
+
+    banker_mt_t mt;
+    banker_locked_t locked;
+    if (combining) banker_mt_init(&mt, m, total);
+    else banker_locked_init(&locked, m, total);
+
+    pthread_t *tid = malloc(threads * sizeof(pthread_t));
+    worker_t *w = malloc(threads * sizeof(worker_t));
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int t = 0; t < threads; ++t) {
+        w[t] = (worker_t){ combining, &mt, &locked, m, requests, (unsigned) t + 1 };
+        if (pthread_create(&tid[t], NULL, worker, &w[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; ++t) pthread_join(tid[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (combining) {
+        *stats = mt;
+        banker_mt_destroy(&mt);
+    } else {
+        banker_locked_destroy(&locked);
+    }
+    free(total); free(tid); free(w);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    return (double) threads * requests / secs;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = (argc > 1) ? atoi(argv[1]) : 32;
+    int requests = (argc > 2) ? atoi(argv[2]) : 100000;
+    int m = (argc > 3) ? atoi(argv[3]) : 8;
+    if (max_threads <= 0 || requests <= 0 || m <= 0) {
+        fprintf(stderr, "Usage: %s [max_threads] [requests_per_thread] [resources]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d requests per thread, %d resource types, claim %d, release every %d grants\n\n",
+           requests, m, CLAIM, HOLD);
+    printf("%-8s %16s %16s %10s %10s\n", "threads", "combining (/s)", "global mutex (/s)",
+           "avg batch", "fallbacks");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        banker_mt_t stats;
+        double combining = run(1, threads, requests, m, &stats);
+        double locked = run(0, threads, requests, m, NULL);
+        printf("%-8d %16.0f %16.0f %10.2f %10ld\n", threads, combining, locked,
+               stats.batches ? (double) stats.batched_requests / stats.batches : 0.0,
+               stats.batch_fallbacks);
+    }
+    return 0;
+}
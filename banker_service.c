@@ -0,0 +1,228 @@
+/*
+ * banker_service.c
+ *
+ * Banker's Algorithm as a live admission controller.
+ *
+ * Compile:
+ *   gcc -O2 -march=native -o banker_service banker_service.c
+ *
+ * Run:
+ *   ./banker_service < commands.txt
+ *   ./banker_service bench [processes] [resources] [operations]
+ *
+ * Command stream (one command per line, '#' starts a comment):
+ *   init <m> <total_0> ... <total_m-1>   must come first
+ *   add <max_0> ... <max_m-1>            register a process -> its id
+ *   request <pid> <r_0> ... <r_m-1>      granted / wait / unsafe / invalid
+ *   release <pid> <r_0> ... <r_m-1>      give back part of an allocation
+ *   remove <pid>                         process exit, frees everything
+ *   show                                 available vector and safe sequence
+ *
+ * Every command gets one line of reply on stdout, e.g.
+ *   request P1 (1 0 2): granted
+ *
+ * "bench" drives random request/release/exit traffic through the service
+ * twice, once with the incremental safety check and once with a full
+ * check on every request, and prints operations per second for both.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "banker.h"
+
+#define MAX_LINE 4096
+
+// Parse m integers from the rest of a line
+int parse_vector(char **p, int m, int *v) {
+    for (int j = 0; j < m; ++j) {
+        char *end;
+        long x = strtol(*p, &end, 10);
+        if (end == *p || x < 0) return -1;
+        v[j] = (int) x;
+        *p = end;
+    }
+    return 0;
+}
+
+void print_vector(const int *v, int m) {
+    printf("(");
+    for (int j = 0; j < m; ++j) printf(j ? " %d" : "%d", v[j]);
+    printf(")");
+}
+
+int run_commands(FILE *in) {
+    banker_t b;
+    int ready = 0;
+    int *v = NULL;
+    char line[MAX_LINE];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char cmd[16];
+        int used;
+        if (sscanf(line, "%15s%n", cmd, &used) != 1) continue;   // blank line
+        char *p = line + used;
+
+        if (strcmp(cmd, "init") == 0) {
+            int m;
+            if (ready || sscanf(p, "%d%n", &m, &used) != 1 || m <= 0) {
+                fprintf(stderr, "line %d: init <m> <totals...> must come first, once\n", lineno);
+                return 1;
+            }
+            p += used;
+            v = malloc(m * sizeof(int));
+            if (parse_vector(&p, m, v) < 0) {
+                fprintf(stderr, "line %d: init needs %d totals\n", lineno, m);
+                return 1;
+            }
+            banker_init(&b, m, v);
+            ready = 1;
+            printf("init: %d resource types, total ", m);
+            print_vector(v, m);
+            printf("\n");
+            continue;
+        }
+        if (!ready) {
+            fprintf(stderr, "line %d: init must come first\n", lineno);
+            return 1;
+        }
+
+        int pid = -1;
+        if (strcmp(cmd, "add") == 0) {
+            if (parse_vector(&p, b.m, v) < 0) {
+                fprintf(stderr, "line %d: add needs %d values\n", lineno, b.m);
+                continue;
+            }
+            pid = banker_add(&b, v);
+            printf("add ");
+            print_vector(v, b.m);
+            if (pid < 0) printf(": invalid (claim exceeds total)\n");
+            else printf(": P%d\n", pid);
+        } else if (strcmp(cmd, "request") == 0 || strcmp(cmd, "release") == 0) {
+            if (sscanf(p, "%d%n", &pid, &used) != 1 || (p += used, parse_vector(&p, b.m, v)) < 0) {
+                fprintf(stderr, "line %d: %s <pid> needs %d values\n", lineno, cmd, b.m);
+                continue;
+            }
+            int r = (cmd[2] == 'q') ? banker_request(&b, pid, v) : banker_release(&b, pid, v);
+            printf("%s P%d ", cmd, pid);
+            print_vector(v, b.m);
+            printf(": %s\n", (cmd[2] == 'q' || r != BANKER_GRANTED) ? banker_result_name(r) : "done");
+        } else if (strcmp(cmd, "remove") == 0) {
+            if (sscanf(p, "%d", &pid) != 1) {
+                fprintf(stderr, "line %d: remove <pid>\n", lineno);
+                continue;
+            }
+            int r = banker_remove(&b, pid);
+            printf("remove P%d: %s\n", pid, r == BANKER_GRANTED ? "done" : banker_result_name(r));
+        } else if (strcmp(cmd, "show") == 0) {
+            printf("available ");
+            print_vector(b.avail, b.m);
+            printf(", safe sequence:");
+            for (int k = 0; k < b.n; ++k) printf(" P%d", b.seq[k]);
+            printf("\n");
+        } else {
+            fprintf(stderr, "line %d: unknown command '%s'\n", lineno, cmd);
+        }
+    }
+
+    if (ready) {
+        printf("%ld requests settled by the prefix check, %ld needed more\n",
+               b.prefix_checks, b.slow_checks);
+        banker_free(&b);
+    }
+    free(v);
+    return 0;
+}
+
+// Random traffic: processes ask for a unit of a few resources at a time,
+// give back part of what they hold, and now and then exit and get
+// replaced by a new process
+int bench(int nproc, int m, int ops) {
+    int *total = malloc(m * sizeof(int));
+    int *v = malloc(m * sizeof(int));
+    int *pids = malloc(nproc * sizeof(int));
+
+    printf("%d processes, %d resource types, %d operations\n", nproc, m, ops);
+    for (int incremental = 1; incremental >= 0; --incremental) {
+        srand(1);
+        for (int j = 0; j < m; ++j) total[j] = nproc + rand() % nproc;
+
+        banker_t b;
+        banker_init(&b, m, total);
+        b.incremental = incremental;
+        for (int i = 0; i < nproc; ++i) {
+            for (int j = 0; j < m; ++j) v[j] = rand() % (total[j] / 4 + 1);
+            pids[i] = banker_add(&b, v);
+        }
+
+        long results[4] = {0};
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int op = 0; op < ops; ++op) {
+            int i = rand() % nproc;
+            int pid = pids[i];
+            int dice = rand() % 100;
+            const int *need = b.need + (size_t) pid * b.stride;
+            const int *alloc = b.alloc + (size_t) pid * b.stride;
+
+            memset(v, 0, m * sizeof(int));
+            if (dice < 60) {
+                for (int k = 0; k < 3; ++k) {
+                    int j = rand() % m;
+                    if (need[j] > v[j]) v[j]++;
+                }
+                results[banker_request(&b, pid, v)]++;
+            } else if (dice < 98) {
+                for (int j = 0; j < m; ++j) v[j] = alloc[j] / 2;
+                banker_release(&b, pid, v);
+            } else {
+                banker_remove(&b, pid);
+                for (int j = 0; j < m; ++j) v[j] = rand() % (total[j] / 4 + 1);
+                pids[i] = banker_add(&b, v);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        printf("%-12s %10.0f ops/s  granted %ld, wait %ld, unsafe %ld  "
+               "(prefix checks %ld, slow checks %ld)\n",
+               incremental ? "incremental" : "full", ops / secs,
+               results[BANKER_GRANTED], results[BANKER_WAIT], results[BANKER_UNSAFE],
+               b.prefix_checks, b.slow_checks);
+
+        // The state must still be safe with the sequence we kept
+        memcpy(b.row, b.avail, b.stride * sizeof(int));
+        for (int k = 0; k < b.n; ++k) {
+            size_t r = (size_t) b.seq[k] * b.stride;
+            if (!row_fits(b.need + r, b.row, b.stride)) {
+                printf("Kept sequence is not safe at position %d\n", k);
+                return 1;
+            }
+            row_add(b.row, b.alloc + r, b.stride);
+        }
+        banker_free(&b);
+    }
+
+    free(total); free(v); free(pids);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int nproc = (argc > 2) ? atoi(argv[2]) : 1000;
+        int m = (argc > 3) ? atoi(argv[3]) : 16;
+        int ops = (argc > 4) ? atoi(argv[4]) : 200000;
+        if (nproc <= 0 || m <= 0 || ops <= 0) {
+            fprintf(stderr, "Usage: %s bench [processes] [resources] [operations]\n", argv[0]);
+            return 1;
+        }
+        return bench(nproc, m, ops);
+    }
+    return run_commands(stdin);
+}
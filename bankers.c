@@ -4,10 +4,12 @@
  * Banker's Algorithm for Deadlock Avoidance.
  *
  * Compile:
- *   gcc -o banker banker.c
+ *   gcc -O2 -march=native -o banker banker.c -pthread
  *
  * Run:
  *   ./banker
+ *   ./banker bench [n] [m]
+ *   ./banker enum [threads] [seconds] [max_states] [list]
  *
  * The program prompts for:
  *  - number of processes (n)
@@ -18,29 +20,178 @@
  *
  * It prints Need matrix, whether the system is SAFE or NOT SAFE,
  * and, if safe, a safe sequence of processes.
+ *
+ * "bench" builds a random safe instance with n processes and m resource
+ * types (default 2000 x 256) and times both safety algorithms on it. The
+ * instance is the worst case for the sweep loop: only one process becomes
+ * runnable per sweep. Both safe sequences are checked step by step, then
+ * the instance is made unsafe and both algorithms must agree again.
+ *
+ * "enum" reads the same input, then also counts every safe sequence
+ * (banker_enum.h) on the given number of threads, giving up after the
+ * time or state limit (defaults 4 threads, 60 s, 2M states). It prints
+ * the earliest and latest position at which every process can finish,
+ * the processes that are always left for last, and the first 'list'
+ * safe sequences (default 10).
+ *
+ * The matrix layout and both safety algorithms (sweep and sorted-need)
+ * live in banker.h.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "banker.h"
+#include "banker_enum.h"
+
+// Random safe instance: processes finish in the order n-1, n-2, ..., 0 and
+// each one needs exactly what is free at its turn, so a sweep from P0
+// upward only ever finds one runnable process
+int bench(int n, int m) {
+    int stride = row_stride(m);
+    int *alloc = matrix_alloc(n, stride);
+    int *need = matrix_alloc(n, stride);
+    int *avail = matrix_alloc(1, stride);
+    int *work = matrix_alloc(1, stride);
+    int *finish = malloc(n * sizeof(int));
+    int *safe_seq = malloc(n * sizeof(int));
+
+    srand(1);
+    for (int j = 0; j < m; ++j) {
+        avail[j] = 1 + rand() % 10;
+        work[j] = avail[j];
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        for (int j = 0; j < m; ++j) {
+            need[(size_t) i * stride + j] = work[j];
+            alloc[(size_t) i * stride + j] = 1 + rand() % 10;
+            work[j] += alloc[(size_t) i * stride + j];
+        }
+    }
+
+    int ok = 1;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            // P0 finishes last; one more unit of R0 makes it unfinishable
+            need[0]++;
+        }
+        int count[2];
+        for (int a = 0; a < 2; ++a) {
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            if (a == 0) count[a] = safety(n, stride, alloc, need, avail, work, finish, safe_seq);
+            else count[a] = safety_sorted(n, m, stride, alloc, need, avail, work, safe_seq);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+
+            double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            int valid = (count[a] < n) ||
+                        verify_safe_sequence(n, stride, alloc, need, avail, work, safe_seq);
+            printf("%-7s %d processes x %d resources: %-8s %d finished, %.3f s%s\n",
+                   a == 0 ? "sweep" : "sorted", n, m, count[a] == n ? "SAFE" : "NOT SAFE",
+                   count[a], secs, valid ? "" : "  INVALID SEQUENCE");
+            ok = ok && valid;
+        }
+        if (count[0] != count[1] || count[0] != (pass == 0 ? n : n - 1)) {
+            printf("Safety algorithms disagree\n");
+            ok = 0;
+        }
+    }
+
+    free(alloc); free(need); free(avail); free(work);
+    free(finish); free(safe_seq);
+    return ok ? 0 : 1;
+}
+
+void print_sequence(const int *seq, int n) {
+    for (int i = 0; i < n; ++i) {
+        printf("P%d", seq[i]);
+        if (i < n-1) printf(" -> ");
+    }
+    printf("\n");
+}
+
+// What-if report: number of safe sequences and where each process can be
+int enumerate(int n, int m, int stride, const int *alloc, const int *need, const int *avail,
+              int threads, double seconds, long max_states, long list) {
+    if (n > ENUM_MAX_PROCS) {
+        printf("\nCannot count safe sequences of more than %d processes.\n", ENUM_MAX_PROCS);
+        return 1;
+    }
+    banker_enum_t e;
+    banker_enum_init(&e, n, m, stride, alloc, need, avail, threads, max_states);
+    int stop = banker_enum_run(&e, seconds, 1);
+    if (stop != ENUM_RUNNING) {
+        printf("\nCounting stopped at the %s after %ld states (%.3f s); no count.\n",
+               stop == ENUM_TIME_LIMIT ? "time limit" : "state limit", atomic_load(&e.states), e.seconds);
+        banker_enum_free(&e);
+        return 1;
+    }
+
+    char buf[40];
+    printf("\nSafe sequences: %s%s (%ld states, %d threads, %ld subtrees stolen, %.3f s)\n",
+           enum_count_str(e.count, buf), e.count == ENUM_COUNT_MAX ? " or more" : "",
+           atomic_load(&e.states), threads, e.steals, e.seconds);
+    if (e.count > 0) {
+        printf("Positions each process can finish at (0 = first):\n");
+        for (int i = 0; i < n; ++i) printf("P%-3d: %d .. %d\n", i, e.earliest[i], e.latest[i]);
+
+        // The last k positions are forced if exactly k processes can
+        // never finish earlier
+        int forced = 0;
+        for (int k = 1; k < n; ++k) {
+            int in_tail = 0;
+            for (int i = 0; i < n; ++i) in_tail += (e.earliest[i] >= n - k);
+            if (in_tail != k) continue;
+            printf("Always the last %d:", k);
+            for (int i = 0; i < n; ++i) {
+                if (e.earliest[i] >= n - k) printf(" P%d", i);
+            }
+            printf("\n");
+            forced = 1;
+        }
+        if (!forced) printf("No process is forced to finish last.\n");
+
+        if (list > 0) {
+            printf("First %ld safe sequences:\n", list);
+            banker_enum_list(&e, list, print_sequence);
+        }
+    }
+    banker_enum_free(&e);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int bn = (argc > 2) ? atoi(argv[2]) : 2000;
+        int bm = (argc > 3) ? atoi(argv[3]) : 256;
+        if (bn <= 0 || bm <= 0) { fprintf(stderr, "Usage: %s bench [n] [m]\n", argv[0]); return 1; }
+        return bench(bn, bm);
+    }
+    int enum_mode = (argc > 1 && strcmp(argv[1], "enum") == 0);
+    int threads = (enum_mode && argc > 2) ? atoi(argv[2]) : 4;
+    double seconds = (enum_mode && argc > 3) ? atof(argv[3]) : 60;
+    long max_states = (enum_mode && argc > 4) ? atol(argv[4]) : 2000000;
+    long list = (enum_mode && argc > 5) ? atol(argv[5]) : 10;
+    if (threads <= 0 || seconds < 0 || max_states <= 0 || list < 0) {
+        fprintf(stderr, "Usage: %s enum [threads] [seconds] [max_states] [list]\n", argv[0]);
+        return 1;
+    }
 
-int main(void) {
     int n, m;
     printf("Number of processes: ");
     if (scanf("%d", &n) != 1 || n <= 0) { fprintf(stderr, "Invalid number of processes\n"); return 1; }
     printf("Number of resource types: ");
     if (scanf("%d", &m) != 1 || m <= 0) { fprintf(stderr, "Invalid number of resource types\n"); return 1; }
 
-    // allocate matrices/vectors
-    int **alloc = malloc(n * sizeof(int *));
-    int **max = malloc(n * sizeof(int *));
-    int **need = malloc(n * sizeof(int *));
-    for (int i = 0; i < n; ++i) {
-        alloc[i] = malloc(m * sizeof(int));
-        max[i]   = malloc(m * sizeof(int));
-        need[i]  = malloc(m * sizeof(int));
-    }
-    int *avail = malloc(m * sizeof(int));
-    int *work = malloc(m * sizeof(int));
+    // allocate matrices/vectors (contiguous, zero-padded rows)
+    int stride = row_stride(m);
+    int *alloc = matrix_alloc(n, stride);
+    int *max = matrix_alloc(n, stride);
+    int *need = matrix_alloc(n, stride);
+    int *avail = matrix_alloc(1, stride);
+    int *work = matrix_alloc(1, stride);
     int *finish = calloc(n, sizeof(int));
     int *safe_seq = malloc(n * sizeof(int));
 
@@ -48,7 +199,7 @@ int main(void) {
     for (int i = 0; i < n; ++i) {
         printf("Allocation for P%d: ", i);
         for (int j = 0; j < m; ++j) {
-            if (scanf("%d", &alloc[i][j]) != 1) { fprintf(stderr, "Invalid input\n"); return 1; }
+            if (scanf("%d", &alloc[i * stride + j]) != 1) { fprintf(stderr, "Invalid input\n"); return 1; }
         }
     }
 
@@ -56,7 +207,7 @@ int main(void) {
     for (int i = 0; i < n; ++i) {
         printf("Max for P%d: ", i);
         for (int j = 0; j < m; ++j) {
-            if (scanf("%d", &max[i][j]) != 1) { fprintf(stderr, "Invalid input\n"); return 1; }
+            if (scanf("%d", &max[i * stride + j]) != 1) { fprintf(stderr, "Invalid input\n"); return 1; }
         }
     }
 
@@ -68,8 +219,8 @@ int main(void) {
     // Compute Need = Max - Allocation
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < m; ++j) {
-            need[i][j] = max[i][j] - alloc[i][j];
-            if (need[i][j] < 0) need[i][j] = 0; // defensive
+            need[i * stride + j] = max[i * stride + j] - alloc[i * stride + j];
+            if (need[i * stride + j] < 0) need[i * stride + j] = 0; // defensive
         }
     }
 
@@ -77,46 +228,25 @@ int main(void) {
     printf("\nAllocation Matrix:\n");
     for (int i = 0; i < n; ++i) {
         printf("P%-3d: ", i);
-        for (int j = 0; j < m; ++j) printf("%3d ", alloc[i][j]);
+        for (int j = 0; j < m; ++j) printf("%3d ", alloc[i * stride + j]);
         printf("\n");
     }
 
     printf("\nMax Matrix:\n");
     for (int i = 0; i < n; ++i) {
         printf("P%-3d: ", i);
-        for (int j = 0; j < m; ++j) printf("%3d ", max[i][j]);
+        for (int j = 0; j < m; ++j) printf("%3d ", max[i * stride + j]);
         printf("\n");
     }
 
     printf("\nNeed Matrix (Max - Allocation):\n");
     for (int i = 0; i < n; ++i) {
         printf("P%-3d: ", i);
-        for (int j = 0; j < m; ++j) printf("%3d ", need[i][j]);
+        for (int j = 0; j < m; ++j) printf("%3d ", need[i * stride + j]);
         printf("\n");
     }
 
-    // Safety algorithm initialization
-    for (int j = 0; j < m; ++j) work[j] = avail[j];
-
-    int count = 0;
-    while (count < n) {
-        int found = 0;
-        for (int i = 0; i < n; ++i) {
-            if (finish[i]) continue;
-            int j;
-            for (j = 0; j < m; ++j) {
-                if (need[i][j] > work[j]) break;
-            }
-            if (j == m) {
-                // P_i can be satisfied
-                for (int k = 0; k < m; ++k) work[k] += alloc[i][k];
-                safe_seq[count++] = i;
-                finish[i] = 1;
-                found = 1;
-            }
-        }
-        if (!found) break; // no further process can be satisfied
-    }
+    int count = safety(n, stride, alloc, need, avail, work, finish, safe_seq);
 
     int safe = (count == n);
     if (safe) {
@@ -129,11 +259,13 @@ int main(void) {
     } else {
         printf("\nSystem is NOT in a safe state. No safe sequence found.\n");
     }
+    int status = 0;
+    if (enum_mode && safe)
+        status = enumerate(n, m, stride, alloc, need, avail, threads, seconds, max_states, list);
 
     // cleanup
-    for (int i = 0; i < n; ++i) { free(alloc[i]); free(max[i]); free(need[i]); }
     free(alloc); free(max); free(need);
     free(avail); free(work); free(finish); free(safe_seq);
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,78 @@
+/*
+ * cacheline.h
+ *
+ * Cache-line layout helpers for the threaded programs: data that one
+ * side writes (producers, consumers, one thread's statistics) goes on
+ * cache lines of its own, so writing it does not invalidate the line
+ * another CPU is reading or writing (false sharing), and read-only
+ * settings stay off the lines that do get written.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "cacheline.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * CACHE_ALIGNED: on a variable or struct member, start it on a new
+ *   line. A struct with such a member is also padded to whole lines, so
+ *   nothing after it shares its last line either; a region is a struct
+ *   whose first member is CACHE_ALIGNED.
+ * cache_alloc(): aligned_alloc for whole lines (exits on failure).
+ * cache_misses_open() / cache_misses_read(): a hardware counter of the
+ *   cache misses of this thread and every thread it starts afterwards,
+ *   for the benchmark modes. Without a PMU (most VMs) or with
+ *   perf_event_paranoid too high, open returns -1.
+ *
+ * Build with -DCACHE_PACKED to drop the alignment and padding (the
+ * layout before this header existed), e.g. to compare cache misses:
+ *   perf stat -e cache-misses ./prog ...
+ */
+
+#ifndef CACHELINE_H
+#define CACHELINE_H
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define CACHE_LINE 64   // bytes, every x86 and most ARM cores
+
+#ifdef CACHE_PACKED
+#define CACHE_ALIGNED
+#else
+#define CACHE_ALIGNED _Alignas(CACHE_LINE)
+#endif
+
+// Bytes rounded up to whole cache lines
+#define CACHE_ROUND(bytes) (((bytes) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE)
+
+void *cache_alloc(size_t bytes) {
+    void *p = aligned_alloc(CACHE_LINE, CACHE_ROUND(bytes));
+    if (!p) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    return p;
+}
+
+int cache_misses_open(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof a);
+    a.size = sizeof a;
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = PERF_COUNT_HW_CACHE_MISSES;
+    a.inherit = 1;          // count the threads started from now on too
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+// Misses so far (the started threads' once they have been joined)
+uint64_t cache_misses_read(int fd) {
+    uint64_t n = 0;
+    if (read(fd, &n, sizeof n) != sizeof n) return 0;
+    return n;
+}
+
+#endif
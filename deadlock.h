@@ -0,0 +1,279 @@
+/*
+ * deadlock.h
+ *
+ * Deadlock detection (as opposed to avoidance, see banker.h):
+ *
+ *  1. detect_deadlock(): the multi-instance detection algorithm over the
+ *     Allocation and Request matrices. It is the safety algorithm with
+ *     Request in place of Need, so it reuses safety_sorted() (O(n * m)).
+ *     Processes that cannot finish and hold something are deadlocked.
+ *
+ *  2. wfg_t: a wait-for graph for single-instance resources (an edge
+ *     P -> Q means P waits for a resource Q holds) that checks for a
+ *     cycle on every edge insert without walking the whole graph. It
+ *     keeps a topological order of the nodes (Pearce & Kelly's dynamic
+ *     topological sort): an edge that agrees with the order costs O(1);
+ *     otherwise only the nodes whose order lies between the two ends are
+ *     searched, and then re-numbered. Deleting an edge never breaks the
+ *     order, so it costs O(degree).
+ *
+ *     An edge that would close a cycle is reported (the cycle is left in
+ *     g->cycle) and kept aside as "deferred", since the process really
+ *     is waiting. Deferred edges are re-tried whenever an edge goes away,
+ *     e.g. when a deadlock victim is aborted.
+ *
+ * Header-only, on top of banker.h:
+ *   #include "deadlock.h"
+ *   gcc -O2 -march=native prog.c -o prog
+ */
+
+#ifndef DEADLOCK_H
+#define DEADLOCK_H
+#include "banker.h"
+
+// ----------------------------------------------------------------
+// 1. Multi-instance detection
+// ----------------------------------------------------------------
+// Fills deadlocked[] with the deadlocked processes and returns how many
+// there are. Same layout as banker.h (stride-padded rows); work is a
+// stride-long scratch row.
+int detect_deadlock(int n, int m, int stride, const int *alloc, const int *request,
+                    const int *avail, int *work, int *deadlocked) {
+    int *seq = malloc(n * sizeof(int));
+    char *finished = calloc(n, 1);
+    int count = safety_sorted(n, m, stride, alloc, request, avail, work, seq);
+    for (int k = 0; k < count; ++k) finished[seq[k]] = 1;
+
+    // A process holding nothing is not part of a deadlock, even if its
+    // request can never be met
+    int *zero = matrix_alloc(1, stride);
+    int d = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!finished[i] && !row_fits(alloc + (size_t) i * stride, zero, stride))
+            deadlocked[d++] = i;
+    }
+    free(zero); free(seq); free(finished);
+    return d;
+}
+
+// ----------------------------------------------------------------
+// 2. Incremental wait-for graph
+// ----------------------------------------------------------------
+typedef struct {
+    int *v;
+    int n, cap;
+} edge_list_t;
+
+typedef struct {
+    int nodes;
+    edge_list_t *out, *in;     // adjacency both ways (duplicates allowed)
+    int *ord;                  // topological position of every node
+    char *visited;
+    int *stack, *parent;       // search scratch
+    int *delta_f, *delta_b;    // nodes reached forward / backward
+    int nf, nb;
+    int *pool;                 // their positions, to hand out again
+    int *def_u, *def_v;        // deferred (cycle-closing) edges
+    int ndef, defcap;
+    int *cycle;                // last cycle found: cycle[0] -> ... -> cycle[0]
+    int cycle_len;
+    long searches, searched;   // edges that needed a search, nodes visited
+} wfg_t;
+
+void edge_push(edge_list_t *l, int x) {
+    if (l->n == l->cap) {
+        l->cap = l->cap ? 2 * l->cap : 4;
+        l->v = realloc(l->v, l->cap * sizeof(int));
+    }
+    l->v[l->n++] = x;
+}
+
+// Remove one copy of x (order within a list does not matter)
+int edge_erase(edge_list_t *l, int x) {
+    for (int i = 0; i < l->n; ++i) {
+        if (l->v[i] == x) {
+            l->v[i] = l->v[--l->n];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void wfg_init(wfg_t *g, int nodes) {
+    memset(g, 0, sizeof(*g));
+    g->nodes = nodes;
+    g->out = calloc(nodes, sizeof(edge_list_t));
+    g->in = calloc(nodes, sizeof(edge_list_t));
+    g->ord = malloc(nodes * sizeof(int));
+    g->visited = calloc(nodes, 1);
+    g->stack = malloc(nodes * sizeof(int));
+    g->parent = malloc(nodes * sizeof(int));
+    g->delta_f = malloc(nodes * sizeof(int));
+    g->delta_b = malloc(nodes * sizeof(int));
+    g->pool = malloc(nodes * sizeof(int));
+    g->cycle = malloc((nodes + 1) * sizeof(int));
+    for (int i = 0; i < nodes; ++i) g->ord[i] = i;
+}
+
+void wfg_free(wfg_t *g) {
+    for (int i = 0; i < g->nodes; ++i) {
+        free(g->out[i].v);
+        free(g->in[i].v);
+    }
+    free(g->out); free(g->in); free(g->ord); free(g->visited);
+    free(g->stack); free(g->parent); free(g->delta_f); free(g->delta_b);
+    free(g->pool); free(g->def_u); free(g->def_v); free(g->cycle);
+}
+
+// Order array that compare_by_ord() sorts nodes by
+_Thread_local const int *wfg_sort_ord;
+
+int compare_by_ord(const void *a, const void *b) {
+    return wfg_sort_ord[*(const int *)a] - wfg_sort_ord[*(const int *)b];
+}
+
+int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Forward search from y over nodes positioned before ub. Returns 1 if it
+// reaches x (then parent[] holds the path). delta_f gets every node marked.
+int wfg_forward(wfg_t *g, int y, int x, int ub) {
+    int top = 0;
+    g->stack[top++] = y;
+    g->visited[y] = 1;
+    g->parent[y] = -1;
+    g->nf = 0;
+    g->delta_f[g->nf++] = y;
+    while (top > 0) {
+        int u = g->stack[--top];
+        for (int i = 0; i < g->out[u].n; ++i) {
+            int w = g->out[u].v[i];
+            if (w == x) {
+                g->parent[w] = u;
+                return 1;
+            }
+            if (!g->visited[w] && g->ord[w] < ub) {
+                g->visited[w] = 1;
+                g->parent[w] = u;
+                g->stack[top++] = w;
+                g->delta_f[g->nf++] = w;
+            }
+        }
+    }
+    return 0;
+}
+
+// Backward search from x over nodes positioned after lb; delta_b gets
+// every node marked
+void wfg_backward(wfg_t *g, int x, int lb) {
+    int top = 0;
+    g->stack[top++] = x;
+    g->visited[x] = 1;
+    g->nb = 0;
+    g->delta_b[g->nb++] = x;
+    while (top > 0) {
+        int u = g->stack[--top];
+        for (int i = 0; i < g->in[u].n; ++i) {
+            int w = g->in[u].v[i];
+            if (!g->visited[w] && g->ord[w] > lb) {
+                g->visited[w] = 1;
+                g->stack[top++] = w;
+                g->delta_b[g->nb++] = w;
+            }
+        }
+    }
+}
+
+// Insert x -> y into the ordered graph. Returns 0, or the length of the
+// cycle it would close (edge not inserted, cycle left in g->cycle).
+int wfg_insert(wfg_t *g, int x, int y) {
+    if (x == y) {
+        g->cycle[0] = x;
+        return g->cycle_len = 1;
+    }
+    int lb = g->ord[y], ub = g->ord[x];
+    if (lb < ub) {
+        // y is ordered before x: only nodes in [lb, ub] can be affected
+        g->searches++;
+        if (wfg_forward(g, y, x, ub)) {
+            // Cycle x -> y -> ... -> x: the parents lead from x back to y
+            int len = 1;
+            for (int u = g->parent[x]; u != -1; u = g->parent[u]) len++;
+            g->cycle[0] = x;
+            int i = len - 1;
+            for (int u = g->parent[x]; u != -1; u = g->parent[u]) g->cycle[i--] = u;
+
+            for (i = 0; i < g->nf; ++i) g->visited[g->delta_f[i]] = 0;
+            g->searched += g->nf;
+            return g->cycle_len = len;
+        }
+        wfg_backward(g, x, lb);
+        g->searched += g->nf + g->nb;
+
+        // Everything that reaches x moves in front of everything y
+        // reaches, reusing the same set of positions
+        wfg_sort_ord = g->ord;
+        qsort(g->delta_b, g->nb, sizeof(int), compare_by_ord);
+        qsort(g->delta_f, g->nf, sizeof(int), compare_by_ord);
+        int np = 0;
+        for (int i = 0; i < g->nb; ++i) g->pool[np++] = g->ord[g->delta_b[i]];
+        for (int i = 0; i < g->nf; ++i) g->pool[np++] = g->ord[g->delta_f[i]];
+        qsort(g->pool, np, sizeof(int), compare_int);
+        np = 0;
+        for (int i = 0; i < g->nb; ++i) {
+            g->visited[g->delta_b[i]] = 0;
+            g->ord[g->delta_b[i]] = g->pool[np++];
+        }
+        for (int i = 0; i < g->nf; ++i) {
+            g->visited[g->delta_f[i]] = 0;
+            g->ord[g->delta_f[i]] = g->pool[np++];
+        }
+    }
+    edge_push(&g->out[x], y);
+    edge_push(&g->in[y], x);
+    return 0;
+}
+
+// P_x starts waiting for P_y. Returns 0, or the length of the deadlock
+// cycle this closes (in g->cycle); the edge is then kept as deferred.
+int wfg_add_edge(wfg_t *g, int x, int y) {
+    int len = wfg_insert(g, x, y);
+    if (len > 0) {
+        if (g->ndef == g->defcap) {
+            g->defcap = g->defcap ? 2 * g->defcap : 8;
+            g->def_u = realloc(g->def_u, g->defcap * sizeof(int));
+            g->def_v = realloc(g->def_v, g->defcap * sizeof(int));
+        }
+        g->def_u[g->ndef] = x;
+        g->def_v[g->ndef++] = y;
+    }
+    return len;
+}
+
+// P_x stops waiting for P_y. Returns -1 if there was no such edge,
+// otherwise how many deferred edges are still waiting (still deadlocked).
+int wfg_remove_edge(wfg_t *g, int x, int y) {
+    for (int i = 0; i < g->ndef; ++i) {
+        if (g->def_u[i] == x && g->def_v[i] == y) {
+            g->def_u[i] = g->def_u[--g->ndef];
+            g->def_v[i] = g->def_v[g->ndef];
+            return g->ndef;
+        }
+    }
+    if (!edge_erase(&g->out[x], y)) return -1;
+    edge_erase(&g->in[y], x);
+
+    // The order is still valid; see whether deferred edges now fit
+    for (int i = 0; i < g->ndef; ) {
+        if (wfg_insert(g, g->def_u[i], g->def_v[i]) == 0) {
+            g->def_u[i] = g->def_u[--g->ndef];
+            g->def_v[i] = g->def_v[g->ndef];
+        } else {
+            ++i;
+        }
+    }
+    return g->ndef;
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * futex_bench.c
+ *
+ * Contention microbenchmark for the primitives in futex_sync.h against
+ * the pthread / POSIX ones they stand in for.
+ *
+ * Compile:
+ *   gcc -O2 -march=native -o futex_bench futex_bench.c -pthread
+ *
+ * Run:
+ *   ./futex_bench [max_threads] [operations]
+ *
+ * For 1, 2, 4, ... max_threads threads (default 16, operations 1000000
+ * in total per test):
+ *   mutex  every thread locks, bumps a few shared counters (a short
+ *          critical section) and unlocks: pthread_mutex_t vs fmutex_t
+ *   sem    half the threads post, the other half wait: sem_t vs fsem_t
+ *          (one thread does both with 1 thread)
+ *   event  two threads hand a turn back and forth (round trips, the
+ *          thread count does not apply): a pair of sem_t vs a pair of
+ *          fevent_t
+ * Every figure is operations per second; the shared counters are
+ * checked after each run.
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "futex_sync.h"
+
+#define CS_WORDS 4   // counters bumped inside the critical section
+
+typedef struct {
+    int futex;       // 1 = futex_sync.h, 0 = pthread / POSIX
+    int ops;         // per thread
+    int role;        // sem: 1 posts, 0 waits
+} job_t;
+
+pthread_mutex_t pmutex;
+fmutex_t fmutex;
+long shared[CS_WORDS];
+
+sem_t psem, pping, ppong;
+fsem_t fsem;
+fevent_t fping, fpong;
+
+double seconds_since(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+void *mutex_worker(void *arg) {
+    job_t *j = arg;
+    for (int i = 0; i < j->ops; ++i) {
+        if (j->futex) fmutex_lock(&fmutex);
+        else pthread_mutex_lock(&pmutex);
+        for (int k = 0; k < CS_WORDS; ++k) shared[k]++;
+        if (j->futex) fmutex_unlock(&fmutex);
+        else pthread_mutex_unlock(&pmutex);
+    }
+    return NULL;
+}
+
+void *sem_worker(void *arg) {
+    job_t *j = arg;
+    for (int i = 0; i < j->ops; ++i) {
+        if (j->role) {
+            if (j->futex) fsem_post(&fsem);
+            else sem_post(&psem);
+        } else {
+            if (j->futex) fsem_wait(&fsem);
+            else sem_wait(&psem);
+        }
+    }
+    return NULL;
+}
+
+void *pong_worker(void *arg) {
+    job_t *j = arg;
+    for (int i = 0; i < j->ops; ++i) {
+        if (j->futex) {
+            fevent_wait(&fping);
+            fevent_reset(&fping);
+            fevent_set(&fpong);
+        } else {
+            sem_wait(&pping);
+            sem_post(&ppong);
+        }
+    }
+    return NULL;
+}
+
+// Runs fn on threads threads with ops operations in total; returns ops/s
+double run(void *(*fn)(void *), int threads, int ops, int futex) {
+    pthread_t t[64];
+    job_t jobs[64];
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < threads; ++i) {
+        jobs[i].futex = futex;
+        jobs[i].ops = ops / threads;
+        jobs[i].role = i % 2;
+        pthread_create(&t[i], NULL, fn, &jobs[i]);
+    }
+    for (int i = 0; i < threads; ++i) pthread_join(t[i], NULL);
+    return (double) (ops / threads) * threads / seconds_since(&t0);
+}
+
+double bench_mutex(int threads, int ops, int futex) {
+    for (int k = 0; k < CS_WORDS; ++k) shared[k] = 0;
+    double rate = run(mutex_worker, threads, ops, futex);
+    for (int k = 0; k < CS_WORDS; ++k) {
+        if (shared[k] != (long) (ops / threads) * threads) {
+            printf("mutex (%s) lost updates with %d threads\n", futex ? "futex" : "pthread", threads);
+            exit(1);
+        }
+    }
+    return rate;
+}
+
+double bench_sem(int threads, int ops, int futex) {
+    if (threads == 1) {
+        // one thread: post, then wait
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < ops / 2; ++i) {
+            if (futex) { fsem_post(&fsem); fsem_wait(&fsem); }
+            else { sem_post(&psem); sem_wait(&psem); }
+        }
+        return (ops / 2 * 2) / seconds_since(&t0);
+    }
+    double rate = run(sem_worker, threads, ops, futex);
+    int left = futex ? atomic_load(&fsem.value) : 0;
+    if (!futex) sem_getvalue(&psem, &left);
+    if (left != 0) {
+        printf("sem (%s) ended with %d units with %d threads\n", futex ? "futex" : "posix", left, threads);
+        exit(1);
+    }
+    return rate;
+}
+
+double bench_event(int rounds, int futex) {
+    pthread_t t;
+    job_t j = { futex, rounds, 0 };
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&t, NULL, pong_worker, &j);
+    for (int i = 0; i < rounds; ++i) {
+        if (futex) {
+            fevent_set(&fping);
+            fevent_wait(&fpong);
+            fevent_reset(&fpong);
+        } else {
+            sem_post(&pping);
+            sem_wait(&ppong);
+        }
+    }
+    pthread_join(t, NULL);
+    return rounds / seconds_since(&t0);
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = (argc > 1) ? atoi(argv[1]) : 16;
+    int ops = (argc > 2) ? atoi(argv[2]) : 1000000;
+    if (max_threads <= 0 || max_threads > 64 || ops < 2 * max_threads) {
+        fprintf(stderr, "Usage: %s [max_threads<=64] [operations]\n", argv[0]);
+        return 1;
+    }
+
+    pthread_mutex_init(&pmutex, NULL);
+    fmutex_init(&fmutex);
+    sem_init(&psem, 0, 0);
+    sem_init(&pping, 0, 0);
+    sem_init(&ppong, 0, 0);
+    fsem_init(&fsem, 0);
+    fevent_init(&fping, 0);
+    fevent_init(&fpong, 0);
+
+    printf("%ld CPUs online, spinning %s\n", sysconf(_SC_NPROCESSORS_ONLN),
+           fsync_spin_max() ? "on" : "off");
+    printf("%7s %14s %14s %14s %14s\n", "threads", "pthread_mutex", "fmutex", "sem_t", "fsem");
+    for (int n = 1; n <= max_threads; n *= 2) {
+        printf("%7d %14.0f %14.0f %14.0f %14.0f\n", n,
+               bench_mutex(n, ops, 0), bench_mutex(n, ops, 1),
+               bench_sem(n, ops, 0), bench_sem(n, ops, 1));
+    }
+    printf("event round trips/s: sem_t pair %.0f, fevent pair %.0f\n",
+           bench_event(ops / 10, 0), bench_event(ops / 10, 1));
+
+    pthread_mutex_destroy(&pmutex);
+    sem_destroy(&psem);
+    sem_destroy(&pping);
+    sem_destroy(&ppong);
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * futex_sync.h
+ *
+ * Mutex, counting semaphore and event on raw futex(2), for the threaded
+ * programs (producer-consumer, reader-writer). They spin a little before
+ * they sleep in the kernel, which pays off when the other thread holds
+ * the lock (or owes the post) for much less than a system call.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "futex_sync.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * fmutex_t: Drepper's three-state futex mutex (0 free, 1 locked,
+ *   2 locked and maybe somebody asleep). Unlock only makes a system call
+ *   in state 2. Any thread may unlock it, as the reader-writer programs
+ *   need (the last reader out is not always the one that locked).
+ *
+ * fevcount_t: event counter, what fsem_t and the MPMC queue in ring.h
+ *   sleep on. A sleeper reads the counter, registers, re-checks its condition
+ *   and only then sleeps; a signal fences, and bumps the counter and
+ *   wakes one thread only if a registered sleeper has no wake on the way
+ *   yet. So a burst of posts to a sleeping thread costs one FUTEX_WAKE,
+ *   where sem_t makes one per post until the sleeper gets to run.
+ *
+ * fsem_t: a counter plus an event counter. wait_n takes up to max units
+ *   with one CAS, and post_n adds n units with one atomic add (sem_t can
+ *   only do both one unit at a time).
+ *
+ * fevent_t: manual-reset event. set wakes every waiter; reset re-arms.
+ *
+ * Spinning: before sleeping a thread polls with PAUSE for up to twice
+ * the number of polls that recently sufficed (plus a few), never more
+ * than FSYNC_SPIN. Every object keeps that estimate as a running
+ * average: it drifts up while spinning succeeds and down while it does
+ * not. Single-CPU machines never spin, since the thread we would wait
+ * for cannot run meanwhile.
+ */
+
+#ifndef FUTEX_SYNC_H
+#define FUTEX_SYNC_H
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define FSYNC_SPIN 1000   // most polls before sleeping (SMP only)
+
+// Give the other hyper-thread the core while polling
+void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+long fsync_futex(_Atomic int *addr, int op, int val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+int fsync_spin_max(void) {
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? FSYNC_SPIN : 0;
+}
+
+// Polls allowed this time
+int fsync_spin_budget(_Atomic int *estimate, int max) {
+    int budget = 2 * atomic_load_explicit(estimate, memory_order_relaxed) + 16;
+    return budget < max ? budget : max;
+}
+
+// Fold in how many polls it took (or the whole budget, if in vain)
+void fsync_spin_update(_Atomic int *estimate, int polls, int success) {
+    int e = atomic_load_explicit(estimate, memory_order_relaxed);
+    e += success ? (polls - e) / 8 : -e / 8;
+    atomic_store_explicit(estimate, e, memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------
+// Event counter: sleep until a condition holds, without lost wake-ups
+// ----------------------------------------------------------------
+typedef struct {
+    _Atomic int seq;           // futex word, bumped on every wake
+    _Atomic uint64_t sleepers; // registered (low half), wakes on the way (high half)
+} fevcount_t;
+
+void fevcount_init(fevcount_t *ev) {
+    atomic_init(&ev->seq, 0);
+    atomic_init(&ev->sleepers, 0);
+}
+
+// Sleep until ready() or a wake-up; one round, the caller loops
+void fevcount_wait(fevcount_t *ev, int (*ready)(void *), void *arg) {
+    // The key is read before registering: a wake counted for us bumps seq
+    // after we registered, so it always gets us out of FUTEX_WAIT
+    int key = atomic_load(&ev->seq);
+    atomic_fetch_add(&ev->sleepers, 1);
+    if (!ready(arg)) fsync_futex(&ev->seq, FUTEX_WAIT_PRIVATE, key);
+
+    // Leave, taking one pending wake with us if there is one
+    uint64_t s = atomic_load_explicit(&ev->sleepers, memory_order_relaxed), n;
+    do {
+        uint64_t pending = s >> 32;
+        n = ((pending ? pending - 1 : 0) << 32) | ((s & 0xffffffffu) - 1);
+    } while (!atomic_compare_exchange_weak(&ev->sleepers, &s, n));
+}
+
+// Called after publishing something a sleeper may be waiting for. Only
+// sleepers no wake is on the way to yet cost a system call, so a burst
+// of puts wakes a sleeping consumer once, not once per item. Returns 1
+// if it woke somebody.
+int fevcount_signal(fevcount_t *ev) {
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t s = atomic_load_explicit(&ev->sleepers, memory_order_relaxed);
+    while ((s & 0xffffffffu) > (s >> 32)) {
+        if (atomic_compare_exchange_weak(&ev->sleepers, &s, s + (1ULL << 32))) {
+            atomic_fetch_add(&ev->seq, 1);
+            fsync_futex(&ev->seq, FUTEX_WAKE_PRIVATE, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Wake up to n sleepers, stopping at the first signal that finds nobody
+void fevcount_signal_n(fevcount_t *ev, int n) {
+    for (int i = 0; i < n && fevcount_signal(ev); ++i) {}
+}
+
+// ----------------------------------------------------------------
+// Mutex
+// ----------------------------------------------------------------
+typedef struct {
+    _Atomic int state;      // 0 free, 1 locked, 2 locked + sleepers
+    _Atomic int spin_est;   // polls that usually suffice
+    int spin_max;
+} fmutex_t;
+
+void fmutex_init(fmutex_t *m) {
+    atomic_init(&m->state, 0);
+    atomic_init(&m->spin_est, 0);
+    m->spin_max = fsync_spin_max();
+}
+
+int fmutex_trylock(fmutex_t *m) {
+    int c = 0;
+    return atomic_compare_exchange_strong(&m->state, &c, 1);
+}
+
+void fmutex_lock(fmutex_t *m) {
+    if (fmutex_trylock(m)) return;
+
+    int budget = fsync_spin_budget(&m->spin_est, m->spin_max);
+    for (int polls = 1; polls <= budget; ++polls) {
+        cpu_relax();
+        if (atomic_load_explicit(&m->state, memory_order_relaxed) == 0 && fmutex_trylock(m)) {
+            fsync_spin_update(&m->spin_est, polls, 1);
+            return;
+        }
+    }
+    if (budget > 0) fsync_spin_update(&m->spin_est, budget, 0);
+
+    // Park: mark the lock contended, sleep while it stays that way
+    int c = atomic_exchange(&m->state, 2);
+    while (c != 0) {
+        fsync_futex(&m->state, FUTEX_WAIT_PRIVATE, 2);
+        c = atomic_exchange(&m->state, 2);
+    }
+}
+
+void fmutex_unlock(fmutex_t *m) {
+    if (atomic_fetch_sub(&m->state, 1) != 1) {
+        atomic_store(&m->state, 0);
+        fsync_futex(&m->state, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+// ----------------------------------------------------------------
+// Counting semaphore
+// ----------------------------------------------------------------
+typedef struct {
+    _Atomic int value;
+    fevcount_t nonzero;     // waiters sleep here
+    _Atomic int spin_est;
+    int spin_max;
+} fsem_t;
+
+void fsem_init(fsem_t *s, int value) {
+    atomic_init(&s->value, value);
+    fevcount_init(&s->nonzero);
+    atomic_init(&s->spin_est, 0);
+    s->spin_max = fsync_spin_max();
+}
+
+// Take up to max units if there are any; returns how many
+int fsem_trywait_n(fsem_t *s, int max) {
+    int v = atomic_load_explicit(&s->value, memory_order_relaxed);
+    while (v > 0) {
+        int n = v < max ? v : max;
+        if (atomic_compare_exchange_weak(&s->value, &v, v - n)) return n;
+    }
+    return 0;
+}
+
+int fsem_trywait(fsem_t *s) {
+    return fsem_trywait_n(s, 1);
+}
+
+int fsem_has_units(void *arg) {
+    fsem_t *s = arg;
+    return atomic_load(&s->value) > 0;
+}
+
+// Wait for at least one unit, then take up to max
+int fsem_wait_n(fsem_t *s, int max) {
+    int n = fsem_trywait_n(s, max);
+    if (n > 0) return n;
+
+    int budget = fsync_spin_budget(&s->spin_est, s->spin_max);
+    for (int polls = 1; polls <= budget; ++polls) {
+        cpu_relax();
+        if (atomic_load_explicit(&s->value, memory_order_relaxed) > 0 &&
+            (n = fsem_trywait_n(s, max)) > 0) {
+            fsync_spin_update(&s->spin_est, polls, 1);
+            return n;
+        }
+    }
+    if (budget > 0) fsync_spin_update(&s->spin_est, budget, 0);
+
+    while ((n = fsem_trywait_n(s, max)) == 0) fevcount_wait(&s->nonzero, fsem_has_units, s);
+    return n;
+}
+
+void fsem_wait(fsem_t *s) {
+    fsem_wait_n(s, 1);
+}
+
+void fsem_post_n(fsem_t *s, int n) {
+    atomic_fetch_add(&s->value, n);
+    fevcount_signal_n(&s->nonzero, n);
+}
+
+void fsem_post(fsem_t *s) {
+    fsem_post_n(s, 1);
+}
+
+// ----------------------------------------------------------------
+// Event (manual reset)
+// ----------------------------------------------------------------
+typedef struct {
+    _Atomic int state;      // futex word: 0 clear, 1 set
+    _Atomic int sleepers;
+    _Atomic int spin_est;
+    int spin_max;
+} fevent_t;
+
+void fevent_init(fevent_t *e, int set) {
+    atomic_init(&e->state, set ? 1 : 0);
+    atomic_init(&e->sleepers, 0);
+    atomic_init(&e->spin_est, 0);
+    e->spin_max = fsync_spin_max();
+}
+
+void fevent_set(fevent_t *e) {
+    atomic_store(&e->state, 1);
+    if (atomic_load(&e->sleepers) > 0) fsync_futex(&e->state, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+void fevent_reset(fevent_t *e) {
+    atomic_store(&e->state, 0);
+}
+
+void fevent_wait(fevent_t *e) {
+    if (atomic_load_explicit(&e->state, memory_order_acquire)) return;
+
+    int budget = fsync_spin_budget(&e->spin_est, e->spin_max);
+    for (int polls = 1; polls <= budget; ++polls) {
+        cpu_relax();
+        if (atomic_load_explicit(&e->state, memory_order_acquire)) {
+            fsync_spin_update(&e->spin_est, polls, 1);
+            return;
+        }
+    }
+    if (budget > 0) fsync_spin_update(&e->spin_est, budget, 0);
+
+    while (!atomic_load(&e->state)) {
+        atomic_fetch_add(&e->sleepers, 1);
+        fsync_futex(&e->state, FUTEX_WAIT_PRIVATE, 0);
+        atomic_fetch_sub(&e->sleepers, 1);
+    }
+}
+
+#endif
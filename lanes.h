@@ -0,0 +1,203 @@
+/*
+ * lanes.h
+ *
+ * Multi-lane bounded buffer for the producer-consumer programs: items
+ * of different priority (say latency-critical and bulk) go into lanes
+ * of their own, so a burst in one lane does not queue up in front of
+ * the others.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "lanes.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * lanes_t: up to LANE_MAX lanes, each a circular buffer with a capacity
+ *   of its own. A put goes into the lane the producer names and blocks
+ *   only while that lane is full (per-lane backpressure: a full bulk
+ *   lane does not hold up urgent puts). A get takes the next items by
+ *   the buffer's policy:
+ *     strict    the lowest-numbered non-empty lane first, always. Lane 0
+ *               is never delayed by the others; they may starve while
+ *               it stays busy.
+ *     weighted  lanes take turns (weighted round robin): a lane is
+ *               served for up to weight[i] items in a row, then the next
+ *               non-empty lane gets its turn. A lane that runs empty
+ *               loses the rest of its turn.
+ *   The lanes that have items are bits in one word (nonempty), so
+ *   finding the next lane is one count-trailing-zeros either way,
+ *   however many lanes there are.
+ *
+ *   One fmutex_t (futex_sync.h) covers all lanes, as in the locked
+ *   buffer: a get has to look at every lane at once. Sleepers use
+ *   fevcount_t, consumers on not_empty and producers on their lane's
+ *   not_full. lanes_close() says no more puts are coming; lanes_get_n
+ *   then returns 0 once every lane is empty.
+ *
+ * Items are ints (lane_item_t); define LANE_ITEM_T before the include
+ * to change that.
+ */
+
+#ifndef LANES_H
+#define LANES_H
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "futex_sync.h"   // fmutex_t, fevcount_t
+#include "cacheline.h"
+
+#define LANE_MAX 32       // bits in nonempty
+
+#ifndef LANE_ITEM_T
+#define LANE_ITEM_T int
+#endif
+typedef LANE_ITEM_T lane_item_t;
+
+typedef struct {
+    lane_item_t *buf;
+    int capacity;
+    int head;                  // oldest item (under the lock)
+    _Atomic int count;         // items in the lane (written under the lock)
+    int weight;                // items per turn, weighted policy
+    fevcount_t not_full;       // this lane's producers sleep here
+} lane_t;
+
+typedef struct {
+    // written under lock
+    CACHE_ALIGNED fmutex_t lock;
+    _Atomic uint32_t nonempty; // bit i: lane i has items
+    int cur;                   // weighted: lane whose turn it is
+    int credit;                // ... and the items it may still take
+    // consumers
+    CACHE_ALIGNED fevcount_t not_empty;
+    _Atomic int closed;
+    // read-only after init, but for each lane's head and count
+    CACHE_ALIGNED int n;
+    int strict;
+    lane_t lanes[LANE_MAX];
+} lanes_t;
+
+// n lanes of capacity[i] items; weight[i] >= 1, or NULL for strict priority
+void lanes_init(lanes_t *q, int n, const int *capacity, const int *weight) {
+    fmutex_init(&q->lock);
+    atomic_init(&q->nonempty, 0);
+    q->cur = 0;
+    q->credit = 0;
+    fevcount_init(&q->not_empty);
+    atomic_init(&q->closed, 0);
+    q->n = n;
+    q->strict = weight == NULL;
+    for (int i = 0; i < n; ++i) {
+        lane_t *l = &q->lanes[i];
+        l->buf = cache_alloc(sizeof(lane_item_t) * capacity[i]);
+        l->capacity = capacity[i];
+        l->head = 0;
+        atomic_init(&l->count, 0);
+        l->weight = weight ? weight[i] : 0;
+        fevcount_init(&l->not_full);
+    }
+}
+
+void lanes_destroy(lanes_t *q) {
+    for (int i = 0; i < q->n; ++i) free(q->lanes[i].buf);
+}
+
+// Conditions a sleeper re-checks after registering
+int lane_has_room(void *arg) {
+    lane_t *l = arg;
+    return atomic_load(&l->count) < l->capacity;
+}
+
+int lanes_ready(void *arg) {
+    lanes_t *q = arg;
+    return atomic_load(&q->nonempty) != 0 || atomic_load(&q->closed);
+}
+
+// Lane to take from next (under the lock, some lane has items)
+int lanes_pick(lanes_t *q) {
+    uint32_t ne = atomic_load_explicit(&q->nonempty, memory_order_relaxed);
+    if (q->strict) return __builtin_ctz(ne);
+    if (q->credit > 0 && (ne >> q->cur & 1)) return q->cur;
+    uint32_t after = ne & ~((2u << q->cur) - 1);   // lanes past cur, then wrap
+    q->cur = __builtin_ctz(after ? after : ne);
+    q->credit = q->lanes[q->cur].weight;
+    return q->cur;
+}
+
+// Put up to n items into lane i if it has room; returns how many
+int lanes_try_put_n(lanes_t *q, int i, const lane_item_t *x, int n) {
+    lane_t *l = &q->lanes[i];
+    fmutex_lock(&q->lock);
+    int count = atomic_load_explicit(&l->count, memory_order_relaxed);
+    if (n > l->capacity - count) n = l->capacity - count;
+    int at = (l->head + count) % l->capacity;
+    int first = l->capacity - at < n ? l->capacity - at : n;
+    memcpy(l->buf + at, x, first * sizeof(lane_item_t));
+    memcpy(l->buf, x + first, (n - first) * sizeof(lane_item_t));
+    atomic_store_explicit(&l->count, count + n, memory_order_relaxed);
+    if (n > 0) atomic_fetch_or_explicit(&q->nonempty, 1u << i, memory_order_relaxed);
+    fmutex_unlock(&q->lock);
+    if (n > 0) fevcount_signal_n(&q->not_empty, n);
+    return n;
+}
+
+// Put all n items into lane i, waiting while it is full
+void lanes_put_n(lanes_t *q, int i, const lane_item_t *x, int n) {
+    while (n > 0) {
+        int k = lanes_try_put_n(q, i, x, n);
+        if (k == 0) fevcount_wait(&q->lanes[i].not_full, lane_has_room, &q->lanes[i]);
+        x += k;
+        n -= k;
+    }
+}
+
+// Take up to max items, lane by lane as the policy says; returns how many
+int lanes_try_get_n(lanes_t *q, lane_item_t *x, int max) {
+    int taken[LANE_MAX];
+    uint32_t touched = 0;
+    int got = 0;
+    fmutex_lock(&q->lock);
+    while (got < max && atomic_load_explicit(&q->nonempty, memory_order_relaxed)) {
+        int i = lanes_pick(q);
+        lane_t *l = &q->lanes[i];
+        int count = atomic_load_explicit(&l->count, memory_order_relaxed);
+        int k = count < max - got ? count : max - got;
+        if (!q->strict && k > q->credit) k = q->credit;
+        int first = l->capacity - l->head < k ? l->capacity - l->head : k;
+        memcpy(x + got, l->buf + l->head, first * sizeof(lane_item_t));
+        memcpy(x + got + first, l->buf, (k - first) * sizeof(lane_item_t));
+        l->head = (l->head + k) % l->capacity;
+        atomic_store_explicit(&l->count, count - k, memory_order_relaxed);
+        if (count == k) atomic_fetch_and_explicit(&q->nonempty, ~(1u << i), memory_order_relaxed);
+        if (!q->strict) q->credit -= k;
+        if (!(touched >> i & 1)) taken[i] = 0;
+        touched |= 1u << i;
+        taken[i] += k;
+        got += k;
+    }
+    fmutex_unlock(&q->lock);
+    for (; touched; touched &= touched - 1) {
+        int i = __builtin_ctz(touched);
+        fevcount_signal_n(&q->lanes[i].not_full, taken[i]);
+    }
+    return got;
+}
+
+// Wait for at least one item, then take up to max; 0 once closed and empty
+int lanes_get_n(lanes_t *q, lane_item_t *x, int max) {
+    for (;;) {
+        int closed = atomic_load(&q->closed);   // every put comes before the close
+        int n = lanes_try_get_n(q, x, max);
+        if (n > 0) return n;
+        if (closed) return 0;
+        fevcount_wait(&q->not_empty, lanes_ready, q);
+    }
+}
+
+// No more puts: wake every consumer so it can drain and finish
+void lanes_close(lanes_t *q) {
+    atomic_store(&q->closed, 1);
+    fevcount_signal_n(&q->not_empty, INT_MAX);
+}
+
+#endif
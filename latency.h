@@ -0,0 +1,116 @@
+/*
+ * latency.h
+ *
+ * Timestamps and latency histograms for the benchmark modes of the
+ * threaded programs.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "latency.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * lat_now() reads the time stamp counter on x86 (a few ns, no system
+ * call) and CLOCK_MONOTONIC elsewhere; call lat_calibrate() once before
+ * converting ticks to nanoseconds with lat_ns(). The TSC is assumed to
+ * be invariant and in sync across cores, as on every x86 of the last
+ * decade.
+ *
+ * lat_hist_t: log-linear histogram of nanosecond values. Values below
+ * 64 get a bucket each; above that every power of two is split into
+ * LAT_SUB buckets, so a percentile is off by at most 1/LAT_SUB (about
+ * 3%). Each thread fills its own histogram and they are merged at the
+ * end, so recording is one increment with no sharing.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define LAT_SUB     32                           // buckets per power of two
+#define LAT_MAX_EXP 40                           // up to 2^40 ns (about 18 minutes)
+#define LAT_BUCKETS ((LAT_MAX_EXP - 4) * LAT_SUB)
+
+typedef struct {
+    uint64_t count[LAT_BUCKETS];
+    uint64_t n;
+    uint64_t max;
+    double sum;
+} lat_hist_t;
+
+double lat_ns_per_tick = 1.0;
+
+uint64_t lat_clock_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+uint64_t lat_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return lat_clock_ns();
+#endif
+}
+
+// Measure the tick rate against CLOCK_MONOTONIC for about 20 ms
+void lat_calibrate(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t c0 = lat_clock_ns(), t0 = lat_now(), c1;
+    while ((c1 = lat_clock_ns()) - c0 < 20000000) {}
+    lat_ns_per_tick = (double) (c1 - c0) / (double) (lat_now() - t0);
+#endif
+}
+
+uint64_t lat_ns(uint64_t ticks) {
+    return (uint64_t) (ticks * lat_ns_per_tick);
+}
+
+void lat_init(lat_hist_t *h) {
+    memset(h, 0, sizeof *h);
+}
+
+int lat_bucket(uint64_t ns) {
+    if (ns < 2 * LAT_SUB) return (int) ns;
+    int e = 63 - __builtin_clzll(ns);                   // 2^e <= ns
+    if (e >= LAT_MAX_EXP) return LAT_BUCKETS - 1;
+    return (e - 5) * LAT_SUB + (int) (ns >> (e - 5));   // top 6 bits: LAT_SUB..2*LAT_SUB-1
+}
+
+// Smallest value that lands in bucket b
+uint64_t lat_bucket_low(int b) {
+    if (b < 2 * LAT_SUB) return b;
+    int e = b / LAT_SUB + 4;
+    return (uint64_t) (b % LAT_SUB + LAT_SUB) << (e - 5);
+}
+
+void lat_add(lat_hist_t *h, uint64_t ns) {
+    h->count[lat_bucket(ns)]++;
+    h->n++;
+    h->sum += ns;
+    if (ns > h->max) h->max = ns;
+}
+
+void lat_merge(lat_hist_t *into, const lat_hist_t *h) {
+    for (int b = 0; b < LAT_BUCKETS; ++b) into->count[b] += h->count[b];
+    into->n += h->n;
+    into->sum += h->sum;
+    if (h->max > into->max) into->max = h->max;
+}
+
+// Value at quantile q (0..1): the low end of the bucket holding it
+uint64_t lat_percentile(const lat_hist_t *h, double q) {
+    if (h->n == 0) return 0;
+    uint64_t rank = (uint64_t) (q * (h->n - 1)), seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; ++b) {
+        seen += h->count[b];
+        if (seen > rank) return lat_bucket_low(b);
+    }
+    return h->max;
+}
+
+#endif
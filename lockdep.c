@@ -0,0 +1,370 @@
+/*
+ * lockdep.c
+ *
+ * Runtime lock-order validator for pthread programs, in the style of the
+ * Linux kernel's lockdep. It is preloaded into an unmodified program and
+ * sits in front of pthread_mutex_lock / trylock / unlock and
+ * pthread_cond_wait / timedwait.
+ *
+ * Compile:
+ *   gcc -O2 -shared -fPIC -o liblockdep.so lockdep.c -ldl -pthread
+ *
+ * Run (build the program with -rdynamic so locks are reported by name):
+ *   gcc -rdynamic -o producer_consumer prodcons.c -pthread
+ *   LD_PRELOAD=./liblockdep.so ./producer_consumer 2 3 5 10
+ *
+ * Every mutex is its own lock class. Whenever a thread takes lock B while
+ * its most recent lock is A, the edge A -> B is recorded once in a global
+ * set of order edges. The first time an edge shows up, the validator
+ * searches the edges for a path back (B -> ... -> A). If there is one,
+ * two threads could each hold one end and wait for the other, so the
+ * cycle is reported on stderr with the place every edge was first seen.
+ * The report comes whether or not the deadlock actually happened.
+ *
+ * Also reported:
+ *   - a thread locking a (non-recursive) mutex it already holds
+ *   - a thread unlocking a mutex that another thread locked, which POSIX
+ *     leaves undefined. readerwriter.c does this: the first reader locks
+ *     resource_mutex and the last reader unlocks it.
+ *
+ * Overhead: the class and edge tables are lock-free open-addressing hash
+ * tables. Once a program's lock orders have all been seen, a lock costs
+ * two table probes that only read, plus one store to the class entry
+ * recording the owner. Nothing is allocated and nothing is locked. The
+ * cycle search only runs for edges that are new.
+ *
+ * Condition waits: glibc releases and re-takes the mutex inside
+ * pthread_cond_wait without going through the public symbols, so the
+ * wrappers do the bookkeeping around the real call: the mutex leaves
+ * this thread's held stack and loses its owner for the wait, and comes
+ * back on top when the wait returns. The re-acquire records no order
+ * edge: the waiter holds nothing it took after the mutex (those would
+ * have to be released first), so it cannot deadlock there.
+ *
+ * Known limits: a mutex freed and reused at the same address keeps its
+ * class; a trylock records no edge, since it cannot wait.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOCKDEP_CLASSES (1 << 14)   // distinct mutexes (power of two)
+#define LOCKDEP_EDGES   (1 << 16)   // distinct order edges (power of two)
+#define LOCKDEP_HELD    32          // locks one thread can hold at once
+
+typedef struct {
+    _Atomic uintptr_t key;     // mutex address, 0 = free slot
+    _Atomic int id;            // class number + 1, 0 while being set up
+} class_slot_t;
+
+// One lock class; aligned so owner stores do not share a cache line
+typedef struct {
+    _Alignas(64) _Atomic(void *) owner;   // thread that last locked it
+    uintptr_t addr;
+    _Atomic int succ;          // first order edge out of this class, -1 = none
+    _Atomic int reported;      // cross-thread unlock already reported
+} lock_class_t;
+
+typedef struct {
+    int from, to;
+    void *site;                // call site where the edge was first seen
+    int next;                  // next edge out of 'from'
+} order_edge_t;
+
+typedef struct {
+    int cls;
+    void *site;
+} held_lock_t;
+
+static int (*real_lock)(pthread_mutex_t *);
+static int (*real_trylock)(pthread_mutex_t *);
+static int (*real_unlock)(pthread_mutex_t *);
+static int (*real_cond_wait)(pthread_cond_t *, pthread_mutex_t *);
+static int (*real_cond_timedwait)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *);
+
+static class_slot_t class_table[LOCKDEP_CLASSES];
+static lock_class_t classes[LOCKDEP_CLASSES];
+static _Atomic int nclasses;
+
+static _Atomic uint64_t edge_table[LOCKDEP_EDGES];   // (from + 1) << 32 | (to + 1)
+static order_edge_t edges[LOCKDEP_EDGES];
+static _Atomic int nedges;
+
+static atomic_flag search_lock = ATOMIC_FLAG_INIT;   // cycle search and reports
+static int visit_mark[LOCKDEP_CLASSES], visit_epoch;
+static int path_edge[LOCKDEP_CLASSES], search_stack[LOCKDEP_CLASSES];
+static _Atomic int full_reported;
+
+static __thread held_lock_t held[LOCKDEP_HELD] __attribute__((tls_model("initial-exec")));
+static __thread int nheld __attribute__((tls_model("initial-exec")));
+static __thread int self_tag __attribute__((tls_model("initial-exec")));   // its address is the owner tag
+
+__attribute__((constructor))
+static void lockdep_init(void) {
+    real_lock = dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    real_trylock = dlsym(RTLD_NEXT, "pthread_mutex_trylock");
+    real_unlock = dlsym(RTLD_NEXT, "pthread_mutex_unlock");
+    // plain dlsym may give the old (2.2.5) condvar ABI; ask for the current one
+    real_cond_wait = dlvsym(RTLD_NEXT, "pthread_cond_wait", "GLIBC_2.3.2");
+    real_cond_timedwait = dlvsym(RTLD_NEXT, "pthread_cond_timedwait", "GLIBC_2.3.2");
+    if (!real_cond_wait) real_cond_wait = dlsym(RTLD_NEXT, "pthread_cond_wait");
+    if (!real_cond_timedwait) real_cond_timedwait = dlsym(RTLD_NEXT, "pthread_cond_timedwait");
+    if (!real_lock || !real_trylock || !real_unlock || !real_cond_wait || !real_cond_timedwait) {
+        fprintf(stderr, "lockdep: cannot find the pthread mutex functions\n");
+        _exit(1);
+    }
+}
+
+static uint64_t hash64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// "name" if the mutex is a global of a -rdynamic program or a library,
+// else its address
+static void lock_name(uintptr_t addr, char *buf, size_t len) {
+    Dl_info info;
+    if (dladdr((void *) addr, &info) && info.dli_sname && (uintptr_t) info.dli_saddr == addr)
+        snprintf(buf, len, "%s", info.dli_sname);
+    else
+        snprintf(buf, len, "mutex@%p", (void *) addr);
+}
+
+static void site_name(void *site, char *buf, size_t len) {
+    Dl_info info;
+    if (dladdr(site, &info) && info.dli_sname)
+        snprintf(buf, len, "%s+0x%lx", info.dli_sname,
+                 (unsigned long) ((char *) site - (char *) info.dli_saddr));
+    else
+        snprintf(buf, len, "%p", site);
+}
+
+static void report_header(const char *what) {
+    fprintf(stderr, "\nlockdep: %s\n", what);
+}
+
+// Class number of a mutex, registering it the first time it is seen
+static int class_of(pthread_mutex_t *m) {
+    uintptr_t key = (uintptr_t) m;
+    for (uint64_t h = hash64(key);; ++h) {
+        class_slot_t *s = &class_table[h & (LOCKDEP_CLASSES - 1)];
+        uintptr_t k = atomic_load_explicit(&s->key, memory_order_acquire);
+        if (k == 0) {
+            if (atomic_load(&nclasses) >= LOCKDEP_CLASSES / 2) {   // keep the table sparse
+                if (!atomic_exchange(&full_reported, 1))
+                    report_header("lock class table full, new mutexes not tracked");
+                return -1;
+            }
+            uintptr_t expect = 0;
+            if (atomic_compare_exchange_strong(&s->key, &expect, key)) {
+                int id = atomic_fetch_add(&nclasses, 1);
+                classes[id].addr = key;
+                atomic_store(&classes[id].succ, -1);
+                atomic_store_explicit(&s->id, id + 1, memory_order_release);
+                return id;
+            }
+            k = expect;
+        }
+        if (k == key) {
+            int id;
+            while ((id = atomic_load_explicit(&s->id, memory_order_acquire)) == 0)
+                ;   // another thread is filling it in
+            return id - 1;
+        }
+    }
+}
+
+// Print the new edge and the path path_edge[] leads back along, to -> ... -> from
+static void report_cycle(int from, int to, void *site) {
+    char a[128], b[128], s[128];
+    report_header("possible lock-order inversion (potential deadlock)");
+    lock_name(classes[from].addr, a, sizeof(a));
+    lock_name(classes[to].addr, b, sizeof(b));
+    site_name(site, s, sizeof(s));
+    fprintf(stderr, "  new order:      %s -> %s  at %s\n", a, b, s);
+    fprintf(stderr, "  existing order:");
+    // walk back from 'from' along path_edge[] to 'to'
+    int chain[LOCKDEP_HELD * 4], len = 0;
+    for (int c = from; c != to && len < (int) (sizeof(chain) / sizeof(chain[0])); c = edges[path_edge[c]].from)
+        chain[len++] = path_edge[c];
+    for (int k = len - 1; k >= 0; --k) {
+        const order_edge_t *e = &edges[chain[k]];
+        lock_name(classes[e->from].addr, a, sizeof(a));
+        lock_name(classes[e->to].addr, b, sizeof(b));
+        site_name(e->site, s, sizeof(s));
+        fprintf(stderr, "%s%s -> %s  at %s\n", k == len - 1 ? " " : "                  ", a, b, s);
+    }
+}
+
+// Record from -> to; on a new edge, look for a path to -> ... -> from
+static void add_order(int from, int to, void *site) {
+    uint64_t key = ((uint64_t) (from + 1) << 32) | (uint64_t) (to + 1);
+    for (uint64_t h = hash64(key);; ++h) {
+        _Atomic uint64_t *slot = &edge_table[h & (LOCKDEP_EDGES - 1)];
+        uint64_t k = atomic_load_explicit(slot, memory_order_relaxed);
+        if (k == key) return;                      // the common case: seen before
+        if (k != 0) continue;
+        if (!atomic_compare_exchange_strong(slot, &k, key)) {
+            if (k == key) return;
+            continue;
+        }
+        break;
+    }
+
+    int e = atomic_fetch_add(&nedges, 1);
+    if (e >= LOCKDEP_EDGES / 2) {                  // keep the table sparse
+        if (!atomic_exchange(&full_reported, 1))
+            report_header("order edge table full, new orders not recorded");
+        return;
+    }
+    edges[e] = (order_edge_t){ from, to, site, 0 };
+
+    while (atomic_flag_test_and_set_explicit(&search_lock, memory_order_acquire))
+        ;
+    // Link it in under the lock, so a search never sees half an edge
+    edges[e].next = atomic_load(&classes[from].succ);
+    atomic_store(&classes[from].succ, e);
+
+    // Depth-first search from 'to' for 'from'
+    int epoch = ++visit_epoch, top = 0;
+    visit_mark[to] = epoch;
+    search_stack[top++] = to;
+    while (top > 0) {
+        int c = search_stack[--top];
+        for (int i = atomic_load(&classes[c].succ); i >= 0; i = edges[i].next) {
+            int w = edges[i].to;
+            if (i == e || visit_mark[w] == epoch) continue;
+            visit_mark[w] = epoch;
+            path_edge[w] = i;
+            if (w == from) {
+                report_cycle(from, to, site);
+                top = 0;
+                break;
+            }
+            search_stack[top++] = w;
+        }
+    }
+    atomic_flag_clear_explicit(&search_lock, memory_order_release);
+}
+
+// Drop entries on top of the held stack that another thread has unlocked
+static void drop_stale(void) {
+    while (nheld > 0 && atomic_load_explicit(&classes[held[nheld - 1].cls].owner,
+                                             memory_order_relaxed) != &self_tag)
+        nheld--;
+}
+
+static void push_held(int cls, void *site) {
+    atomic_store_explicit(&classes[cls].owner, &self_tag, memory_order_relaxed);
+    if (nheld < LOCKDEP_HELD) held[nheld++] = (held_lock_t){ cls, site };
+}
+
+static int is_recursive(pthread_mutex_t *m) {
+#ifdef __GLIBC__
+    return (m->__data.__kind & 3) == PTHREAD_MUTEX_RECURSIVE_NP;
+#else
+    (void) m;
+    return 0;
+#endif
+}
+
+int pthread_mutex_lock(pthread_mutex_t *m) {
+    void *site = __builtin_return_address(0);
+    int cls = class_of(m);
+    if (cls >= 0) {
+        drop_stale();
+        for (int i = nheld - 1; i >= 0; --i) {
+            if (held[i].cls == cls && !is_recursive(m)
+                && atomic_load_explicit(&classes[cls].owner, memory_order_relaxed) == &self_tag) {
+                char a[128], s[128], p[128];
+                lock_name(classes[cls].addr, a, sizeof(a));
+                site_name(site, s, sizeof(s));
+                site_name(held[i].site, p, sizeof(p));
+                report_header("recursive locking (this thread will deadlock)");
+                fprintf(stderr, "  %s locked at %s, already held since %s\n", a, s, p);
+                break;
+            }
+        }
+        if (nheld > 0 && held[nheld - 1].cls != cls) add_order(held[nheld - 1].cls, cls, site);
+    }
+    int r = real_lock(m);
+    if (r == 0 && cls >= 0) push_held(cls, site);
+    return r;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *m) {
+    int r = real_trylock(m);
+    if (r == 0) {
+        int cls = class_of(m);
+        if (cls >= 0) {
+            drop_stale();
+            push_held(cls, __builtin_return_address(0));
+        }
+    }
+    return r;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *m) {
+    int cls = class_of(m);
+    if (cls >= 0) {
+        int i = nheld - 1;
+        while (i >= 0 && held[i].cls != cls) --i;
+        if (i >= 0 && atomic_load_explicit(&classes[cls].owner, memory_order_relaxed) == &self_tag) {
+            memmove(held + i, held + i + 1, (nheld - i - 1) * sizeof(held_lock_t));
+            nheld--;
+            while (--i >= 0 && held[i].cls != cls)
+                ;
+            if (i >= 0) return real_unlock(m);    // a recursive mutex still held
+        } else if (!atomic_exchange(&classes[cls].reported, 1)) {
+            char a[128], s[128];
+            lock_name(classes[cls].addr, a, sizeof(a));
+            site_name(__builtin_return_address(0), s, sizeof(s));
+            while (atomic_flag_test_and_set_explicit(&search_lock, memory_order_acquire))
+                ;
+            report_header("unlock of a mutex this thread does not hold");
+            fprintf(stderr, "  %s unlocked at %s\n", a, s);
+            atomic_flag_clear_explicit(&search_lock, memory_order_release);
+        }
+        atomic_store_explicit(&classes[cls].owner, NULL, memory_order_relaxed);
+    }
+    return real_unlock(m);
+}
+
+// Around a condition wait: the real call unlocks and re-locks m itself.
+// Take m off the held stack for the wait and return where it was locked
+// (site, the wait's caller, if it was not on the stack).
+static void *cond_release(int cls, void *site) {
+    int i = nheld - 1;
+    while (i >= 0 && held[i].cls != cls) --i;
+    if (i < 0 || atomic_load_explicit(&classes[cls].owner, memory_order_relaxed) != &self_tag)
+        return site;
+    site = held[i].site;
+    memmove(held + i, held + i + 1, (nheld - i - 1) * sizeof(held_lock_t));
+    nheld--;
+    atomic_store_explicit(&classes[cls].owner, NULL, memory_order_relaxed);
+    return site;
+}
+
+int pthread_cond_wait(pthread_cond_t *c, pthread_mutex_t *m) {
+    int cls = class_of(m);
+    void *site = cls >= 0 ? cond_release(cls, __builtin_return_address(0)) : NULL;
+    int r = real_cond_wait(c, m);
+    if (cls >= 0) push_held(cls, site);    // held again, with no new order edge
+    return r;
+}
+
+int pthread_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m, const struct timespec *t) {
+    int cls = class_of(m);
+    void *site = cls >= 0 ? cond_release(cls, __builtin_return_address(0)) : NULL;
+    int r = real_cond_timedwait(c, m, t);
+    if (cls >= 0) push_held(cls, site);    // on a timeout too
+    return r;
+}
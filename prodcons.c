@@ -5,9 +5,10 @@
  *
  * Compile:
  *   gcc -o producer_consumer producer_consumer.c -pthread
+ *   (add -DCACHE_PACKED for the old layout, with no cache-line padding)
  *
  * Run:
- *   ./producer_consumer <producers> <consumers> <buffer_size> <items_per_producer>
+ *   ./producer_consumer <producers> <consumers> <buffer_size> <items_per_producer> [lock|futex|spsc|mpmc|slots|shards] [batch] [rr|hash|ordered]
  *
  * Example:
  *   ./producer_consumer 2 3 5 10
@@ -15,6 +16,50 @@
  * This runs 2 producers and 3 consumers with buffer size 5.
  * Each producer will produce 10 items (so total items = producers * items_per_producer).
  * Consumers exit when they have consumed all produced items.
+ *
+ * Termination: producers count the items they have published
+ * (produced), main sets closed once every producer is done, and a
+ * consumer first claims items against that count (claimed, one CAS) and
+ * only then waits on the buffer for them, so it never waits for an item
+ * that is not coming. When produced - claimed is zero a consumer sleeps
+ * on an event counter that every publish and the close wake, and once
+ * closed is set and everything is claimed it leaves. No lock besides the
+ * buffer's, no poison pills and no extra posts.
+ *
+ * The last argument picks the buffer: "lock" (default) is the circular
+ * buffer below with two semaphores and a mutex; "futex" is the same
+ * buffer with the spin-then-park semaphores and mutex from futex_sync.h;
+ * "spsc" is the lock-free single-producer/single-consumer ring from
+ * ring.h (1 producer and 1 consumer only), which blocks only when it is
+ * really full or empty; "mpmc" is the lock-free bounded queue from
+ * ring.h, for any number of producers and consumers.
+ * "slots" sends records of RECORD_BYTES (producer, sequence number and a
+ * payload) instead of packed ints, through the claim/commit queue in
+ * ring.h: the producer writes each record straight into its slot and
+ * the consumer reads it there (batch does not apply).
+ * "shards" gives every consumer a deque of its own (shard.h), of
+ * buffer_size items each. The last argument says where producers put:
+ * "rr" (default) goes round the shards, "hash" picks the shard from the
+ * key (here the producer id), and idle consumers steal from the tails
+ * of the others' shards in both; "ordered" hashes too, but nobody
+ * steals, so every producer's items are consumed in order (consumers
+ * check), at the price of idle consumers when keys are few. Main closes
+ * the shards once the producers are done, and a consumer leaves when
+ * nothing is left for it.
+ *
+ * With a batch > 1 a producer makes 'batch' items at a time and puts
+ * them with one reservation and one copy (a run may wrap around the end
+ * of the buffer), and a consumer takes everything that is there, up to
+ * 'batch', in one go.
+ *
+ * This program sleeps and prints for every item, to be watched. To time
+ * the buffers, use "bench" and "grid" in prodcons_sem.c, which drive the
+ * same backends with no sleeps or prints and report throughput and
+ * enqueue-to-dequeue latency.
+ *
+ * Lock-order check (see lockdep.c):
+ *   gcc -rdynamic -o producer_consumer producer_consumer.c -pthread
+ *   LD_PRELOAD=./liblockdep.so ./producer_consumer 2 3 5 10
  */
 
 #include <stdio.h>
@@ -23,27 +68,65 @@
 #include <semaphore.h>
 #include <unistd.h>     // sleep
 #include <time.h>
+#include <string.h>
+
+#include "futex_sync.h"
+#include "ring.h"
+#include "cacheline.h"
+#include "shard.h"
 
 typedef int item_t;
 
 typedef struct {
-    item_t *buf;
+    item_t *buf;              // read-only after init
     int capacity;
-    int in;   // next insertion index
-    int out;  // next removal index
+    CACHE_ALIGNED int in;     // next insertion index (producers)
+    CACHE_ALIGNED int out;    // next removal index (consumers)
 } buffer_t;
 
 buffer_t buffer;
-sem_t empty;   // counts free slots
-sem_t full;    // counts filled slots
-pthread_mutex_t mutex;
+
+/* Shared state in cache-line regions (cacheline.h), so producers and
+   consumers do not keep taking each other's lines away */
+struct {
+    CACHE_ALIGNED sem_t empty;        // counts free slots; producers wait here
+    fsem_t fempty;                    // BUF_FUTEX: the same, futex_sync.h
+    // written by producers (and main, to close), read by consumers
+    CACHE_ALIGNED _Atomic int produced;  // items published so far
+    _Atomic int closed;               // no more items after produced
+    fevcount_t progress;              // consumers with nothing to claim sleep here
+} prod;
+
+struct {
+    CACHE_ALIGNED sem_t full;         // counts filled slots; consumers wait here
+    fsem_t ffull;
+    // written by consumers only
+    CACHE_ALIGNED _Atomic int claimed;   // items consumers have claimed
+    _Atomic int consumed_count;
+} cons;
+
+struct {
+    CACHE_ALIGNED pthread_mutex_t mutex;  // protects buffer access
+    fmutex_t fmutex;
+} guard;
 
 int producers_count;
 int consumers_count;
 int items_per_producer;
-int total_items;      // producers_count * items_per_producer
-int consumed_count = 0;
-pthread_mutex_t consumed_count_mutex;
+int total_items;      // producers_count * items_per_producer (for the report)
+
+enum { BUF_LOCK, BUF_FUTEX, BUF_SPSC, BUF_MPMC, BUF_SLOTS, BUF_SHARDS };
+const char *buffer_names[] = { "lock", "futex", "spsc", "mpmc", "slots", "shards" };
+int backend = BUF_LOCK;
+spsc_ring_t ring;     // BUF_SPSC: 1 producer, 1 consumer
+mpmc_queue_t queue;   // BUF_MPMC
+slotq_t slots;        // BUF_SLOTS
+shardset_t shardset;  // BUF_SHARDS: one shard per consumer
+
+enum { SHARD_RR, SHARD_HASH, SHARD_ORDERED };
+const char *shard_modes[] = { "rr", "hash", "ordered" };
+int shard_mode = SHARD_RR;
+int batch = 1;        // items per put / most items per get
 
 void buffer_init(buffer_t *b, int capacity) {
     b->buf = malloc(sizeof(item_t) * capacity);
@@ -69,78 +152,299 @@ item_t buffer_get(buffer_t *b) {
     return item;
 }
 
+/* Add n items in one run, wrapping around the end (caller must handle sem/mutex) */
+void buffer_put_n(buffer_t *b, const item_t *items, int n) {
+    int first = b->capacity - b->in < n ? b->capacity - b->in : n;
+    memcpy(b->buf + b->in, items, first * sizeof(item_t));
+    memcpy(b->buf, items + first, (n - first) * sizeof(item_t));
+    b->in = (b->in + n) % b->capacity;
+}
+
+/* Remove n items in one run, wrapping around the end (caller must handle sem/mutex) */
+void buffer_get_n(buffer_t *b, item_t *items, int n) {
+    int first = b->capacity - b->out < n ? b->capacity - b->out : n;
+    memcpy(items, b->buf + b->out, first * sizeof(item_t));
+    memcpy(items + first, b->buf, (n - first) * sizeof(item_t));
+    b->out = (b->out + n) % b->capacity;
+}
+
+/* Wait for one unit of s, then take up to max - 1 more without blocking */
+int sem_wait_n(sem_t *s, int max) {
+    int n = 1;
+    sem_wait(s);
+    while (n < max && sem_trywait(s) == 0) n++;
+    return n;
+}
+
+void sem_post_n(sem_t *s, int n) {
+    while (n-- > 0) sem_post(s);
+}
+
+/* The lock and futex buffers differ only in these */
+int wait_empty(int max) { return backend == BUF_FUTEX ? fsem_wait_n(&prod.fempty, max) : sem_wait_n(&prod.empty, max); }
+int wait_full(int max) { return backend == BUF_FUTEX ? fsem_wait_n(&cons.ffull, max) : sem_wait_n(&cons.full, max); }
+
+void post_empty(int n) {
+    if (backend == BUF_FUTEX) fsem_post_n(&prod.fempty, n);
+    else sem_post_n(&prod.empty, n);
+}
+
+void post_full(int n) {
+    if (backend == BUF_FUTEX) fsem_post_n(&cons.ffull, n);
+    else sem_post_n(&cons.full, n);
+}
+
+void lock_buffer(void) {
+    if (backend == BUF_FUTEX) fmutex_lock(&guard.fmutex);
+    else pthread_mutex_lock(&guard.mutex);
+}
+
+void unlock_buffer(void) {
+    if (backend == BUF_FUTEX) fmutex_unlock(&guard.fmutex);
+    else pthread_mutex_unlock(&guard.mutex);
+}
+
+/* After n items are in the buffer: count them and wake a consumer */
+void publish_items(int n) {
+    atomic_fetch_add(&prod.produced, n);
+    fevcount_signal_n(&prod.progress, n);
+}
+
+/* Once every producer is done: wake every consumer to drain and leave */
+void close_items(void) {
+    atomic_store(&prod.closed, 1);
+    fevcount_signal_n(&prod.progress, INT_MAX);
+}
+
+int claimable_or_closed(void *arg) {
+    (void) arg;
+    return atomic_load(&cons.claimed) < atomic_load(&prod.produced) || atomic_load(&prod.closed);
+}
+
+/* Claim up to max published items, waiting for at least one; returns
+   how many, 0 once closed and everything is claimed. The items are in
+   the buffer or about to be: the caller then gets exactly that many */
+int claim_items(int max) {
+    for (;;) {
+        // closed first: every publish comes before the close, so produced
+        // read after it is final
+        int closed = atomic_load(&prod.closed);
+        int c = atomic_load(&cons.claimed);
+        int ready = atomic_load(&prod.produced) - c;
+        if (ready > 0) {
+            int n = ready < max ? ready : max;
+            if (atomic_compare_exchange_weak(&cons.claimed, &c, c + n)) return n;
+            continue;
+        }
+        if (closed) return 0;
+        fevcount_wait(&prod.progress, claimable_or_closed, NULL);
+    }
+}
+
 /* Simple generator for items (could be any data) */
 item_t produce_item(int producer_id, int seq) {
     // Example: encode producer_id and seq into a single int
     return (producer_id << 16) | (seq & 0xFFFF);
 }
 
+/* A record as sent with "slots": written and read in place */
+#define RECORD_BYTES 4096
+
+typedef struct {
+    int producer;
+    int seq;
+    unsigned char payload[RECORD_BYTES - 2 * sizeof(int)];
+} record_t;
+
 /* Decode helpers for printing */
 int item_producer(item_t it) { return (it >> 16) & 0xFFFF; }
 int item_seq(item_t it) { return it & 0xFFFF; }
 
+void print_produced(int id, int seq, int n, int in) {
+    if (n == 1)
+        printf("[Producer %d] produced item seq=%d, placed at slot. in=%d\n", id, seq, in);
+    else
+        printf("[Producer %d] produced items seq=%d..%d, placed at slots. in=%d\n",
+               id, seq, seq + n - 1, in);
+}
+
+void print_consumed(int id, const item_t *items, int n, int out, int total) {
+    if (n == 1)
+        printf("[Consumer %d] consumed item from producer=%d seq=%d, out=%d (total consumed=%d)\n",
+               id, item_producer(items[0]), item_seq(items[0]), out, total);
+    else
+        printf("[Consumer %d] consumed %d items, first from producer=%d seq=%d, out=%d (total consumed=%d)\n",
+               id, n, item_producer(items[0]), item_seq(items[0]), out, total);
+}
+
+void *record_producer(int id) {
+    for (int i = 1; i <= items_per_producer; ++i) {
+        slot_t s;
+        slotq_claim(&slots, &s);            // wait for a free slot
+        record_t *r = s.data;               // ... and build the record in it
+        r->producer = id;
+        r->seq = i;
+        memset(r->payload, i & 0xFF, sizeof r->payload);
+        slotq_commit(&slots, &s, sizeof *r);
+        publish_items(1);
+        printf("[Producer %d] produced record seq=%d in slot %d\n", id, i, (int) (s.pos & slots.mask));
+        usleep((rand() % 200 + 100) * 1000); // 100-300 ms
+    }
+    printf("[Producer %d] finished producing.\n", id);
+    return NULL;
+}
+
+void *shard_producer(int id) {
+    unsigned cursor = id;           // round-robin, starting at a different shard each
+    item_t *run = malloc(sizeof(item_t) * batch);
+    for (int i = 1; i <= items_per_producer; i += batch) {
+        int k = 0;
+        while (k < batch && i + k <= items_per_producer) {
+            run[k] = produce_item(id, i + k);
+            k++;
+        }
+        int shard = shard_mode == SHARD_RR ? shards_pick_rr(&shardset, &cursor)
+                                           : shards_pick_key(&shardset, id);
+        shards_put_n(&shardset, shard, run, k);
+        if (k == 1)
+            printf("[Producer %d] produced item seq=%d into shard %d\n", id, i, shard);
+        else
+            printf("[Producer %d] produced items seq=%d..%d into shard %d\n", id, i, i + k - 1, shard);
+        usleep((rand() % 200 + 100) * 1000); // 100-300 ms
+    }
+    free(run);
+    printf("[Producer %d] finished producing.\n", id);
+    return NULL;
+}
+
+void *shard_consumer(int id) {
+    item_t *run = malloc(sizeof(item_t) * batch);
+    int *last_seq = calloc(producers_count, sizeof(int));   // per key, for "ordered"
+    for (;;) {
+        int n = shards_get_n(&shardset, id, run, batch);
+        if (n == 0) break;                  // closed and nothing left for us
+        int in_order = 1;
+        for (int j = 0; j < n; ++j) {
+            int p = item_producer(run[j]);
+            if (item_seq(run[j]) < last_seq[p]) in_order = 0;
+            last_seq[p] = item_seq(run[j]);
+        }
+        int local_consumed = atomic_fetch_add(&cons.consumed_count, n) + n;
+        if (n == 1)
+            printf("[Consumer %d] consumed item from producer=%d seq=%d, shard %d (total consumed=%d)\n",
+                   id, item_producer(run[0]), item_seq(run[0]), shards_from, local_consumed);
+        else
+            printf("[Consumer %d] consumed %d items, first from producer=%d seq=%d, shard %d (total consumed=%d)\n",
+                   id, n, item_producer(run[0]), item_seq(run[0]), shards_from, local_consumed);
+        if (shard_mode == SHARD_ORDERED && !in_order) printf("[Consumer %d] OUT OF ORDER\n", id);
+        usleep((rand() % 200 + 150) * 1000); // 150-350 ms
+    }
+    free(last_seq);
+    free(run);
+    printf("[Consumer %d] exiting (no more items).\n", id);
+    return NULL;
+}
+
 void *producer(void *arg) {
     int id = (int)(long)arg;
-    for (int i = 1; i <= items_per_producer; ++i) {
-        item_t it = produce_item(id, i);
+    if (backend == BUF_SLOTS) return record_producer(id);
+    if (backend == BUF_SHARDS) return shard_producer(id);
+    item_t *run = malloc(sizeof(item_t) * batch);
+    for (int i = 1; i <= items_per_producer; i += batch) {
+        int k = 0;
+        while (k < batch && i + k <= items_per_producer) {
+            run[k] = produce_item(id, i + k);
+            k++;
+        }
 
-        sem_wait(&empty);               // wait for free slot
-        pthread_mutex_lock(&mutex);     // enter critical section
-        buffer_put(&buffer, it);
-        printf("[Producer %d] produced item seq=%d, placed at slot. in=%d\n",
-               id, i, buffer.in);
-        pthread_mutex_unlock(&mutex);   // leave critical section
-        sem_post(&full);                // signal filled slot
+        if (backend == BUF_SPSC || backend == BUF_MPMC) {
+            // publish every chunk as soon as it is in: consumers only take
+            // what they have claimed, so items held back here until the
+            // rest of the batch fits would fill the ring for good
+            for (int done = 0; done < k; ) {
+                int n, in;
+                if (backend == BUF_SPSC) {
+                    n = spsc_put_some(&ring, run + done, k - done);
+                    in = (int) (atomic_load(&ring.tail) & ring.mask);
+                } else {
+                    n = mpmc_put_some(&queue, run + done, k - done);
+                    in = (int) (atomic_load(&queue.enqueue_pos) & queue.mask);
+                }
+                publish_items(n);
+                print_produced(id, i + done, n, in);
+                done += n;
+            }
+            usleep((rand() % 200 + 100) * 1000); // 100-300 ms
+            continue;
+        }
+
+        for (int done = 0; done < k; ) {
+            int n = wait_empty(k - done);   // wait for free slots
+            lock_buffer();                  // enter critical section
+            buffer_put_n(&buffer, run + done, n);
+            print_produced(id, i + done, n, buffer.in);
+            unlock_buffer();                // leave critical section
+            post_full(n);                   // signal filled slots
+            publish_items(n);               // ... and let consumers claim them
+            done += n;
+        }
 
         // simulate variable production time
         usleep((rand() % 200 + 100) * 1000); // 100-300 ms
     }
+    free(run);
     printf("[Producer %d] finished producing.\n", id);
     return NULL;
 }
 
 void *consumer(void *arg) {
     int id = (int)(long)arg;
-    while (1) {
-        // If we've consumed all items globally, break out
-        pthread_mutex_lock(&consumed_count_mutex);
-        if (consumed_count >= total_items) {
-            pthread_mutex_unlock(&consumed_count_mutex);
-            break;
+    if (backend == BUF_SHARDS) return shard_consumer(id);
+    item_t *run = malloc(sizeof(item_t) * batch);
+    // claim what is there now (at least one, at most batch); every claimed
+    // item is published, so getting it never waits for a producer
+    for (int n; (n = claim_items(backend == BUF_SLOTS ? 1 : batch)) > 0; ) {
+        if (backend == BUF_SLOTS) {
+            slot_t s;
+            slotq_acquire(&slots, &s);
+            const record_t *r = s.data;         // read in place, no copy
+            int intact = (s.len == sizeof *r && r->payload[0] == (r->seq & 0xFF) &&
+                          r->payload[sizeof r->payload - 1] == (r->seq & 0xFF));
+            int local_consumed = atomic_fetch_add(&cons.consumed_count, 1) + 1;
+            printf("[Consumer %d] consumed record from producer=%d seq=%d%s, slot %d (total consumed=%d)\n",
+                   id, r->producer, r->seq, intact ? "" : " (CORRUPT)", (int) (s.pos & slots.mask),
+                   local_consumed);
+            slotq_release(&slots, &s);          // the slot is free again
+        } else if (backend == BUF_SPSC || backend == BUF_MPMC) {
+            for (int got = 0; got < n; ) {
+                if (backend == BUF_SPSC) got += spsc_get_n(&ring, run + got, n - got);
+                else got += mpmc_get_n(&queue, run + got, n - got);
+            }
+            int local_consumed = atomic_fetch_add(&cons.consumed_count, n) + n;
+            int out = backend == BUF_SPSC ? (int) (atomic_load(&ring.head) & ring.mask)
+                                          : (int) (atomic_load(&queue.dequeue_pos) & queue.mask);
+            print_consumed(id, run, n, out, local_consumed);
+        } else {
+            for (int got = 0; got < n; ) got += wait_full(n - got);   // wait for filled slots
+            lock_buffer();                  // critical section to access buffer
+            buffer_get_n(&buffer, run, n);
+            int local_consumed = atomic_fetch_add(&cons.consumed_count, n) + n;
+            print_consumed(id, run, n, buffer.out, local_consumed);
+            unlock_buffer();                // leave critical section
+            post_empty(n);                  // signal free slots
         }
-        pthread_mutex_unlock(&consumed_count_mutex);
-
-        // Try to consume an item
-        sem_wait(&full);                // wait for a filled slot
-        pthread_mutex_lock(&mutex);     // critical section to access buffer
-        // Double-check: it's possible another consumer consumed the last item
-        pthread_mutex_lock(&consumed_count_mutex);
-        if (consumed_count >= total_items) {
-            // We shouldn't consume; rollback: release locks and post full to avoid deadlock
-            pthread_mutex_unlock(&consumed_count_mutex);
-            pthread_mutex_unlock(&mutex);
-            sem_post(&full);
-            break;
-        }
-        item_t it = buffer_get(&buffer);
-        consumed_count++;
-        int local_consumed = consumed_count;
-        pthread_mutex_unlock(&consumed_count_mutex);
-        printf("[Consumer %d] consumed item from producer=%d seq=%d, out=%d (total consumed=%d)\n",
-               id, item_producer(it), item_seq(it), buffer.out, local_consumed);
-        pthread_mutex_unlock(&mutex);   // leave critical section
-        sem_post(&empty);               // signal free slot
 
         // simulate variable consumption time
         usleep((rand() % 200 + 150) * 1000); // 150-350 ms
     }
+    free(run);
     printf("[Consumer %d] exiting (no more items).\n", id);
     return NULL;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <producers> <consumers> <buffer_size> <items_per_producer>\n", argv[0]);
+    if (argc < 5 || argc > 8) {
+        fprintf(stderr, "Usage: %s <producers> <consumers> <buffer_size> <items_per_producer> [lock|futex|spsc|mpmc|slots|shards] [batch] [rr|hash|ordered]\n", argv[0]);
         return 1;
     }
 
@@ -156,14 +460,49 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (argc >= 6) {
+        for (backend = BUF_SHARDS; backend >= 0 && strcmp(argv[5], buffer_names[backend]) != 0; --backend) {}
+        if (backend < 0) {
+            fprintf(stderr, "Buffer must be lock, futex, spsc, mpmc, slots or shards.\n");
+            return 1;
+        }
+        if (backend == BUF_SPSC && (producers_count != 1 || consumers_count != 1)) {
+            fprintf(stderr, "spsc needs exactly 1 producer and 1 consumer.\n");
+            return 1;
+        }
+    }
+
+    if (argc >= 7) {
+        batch = atoi(argv[6]);
+        if (batch <= 0) {
+            fprintf(stderr, "Batch must be a positive integer.\n");
+            return 1;
+        }
+    }
+
+    if (argc == 8) {
+        for (shard_mode = SHARD_ORDERED; shard_mode >= 0 && strcmp(argv[7], shard_modes[shard_mode]) != 0; --shard_mode) {}
+        if (backend != BUF_SHARDS || shard_mode < 0) {
+            fprintf(stderr, "The last argument is rr, hash or ordered, with shards only.\n");
+            return 1;
+        }
+    }
+
     total_items = producers_count * items_per_producer;
 
     buffer_init(&buffer, buffer_size);
+    if (backend == BUF_SPSC) spsc_init(&ring, buffer_size);
+    if (backend == BUF_MPMC) mpmc_init(&queue, buffer_size);
+    if (backend == BUF_SLOTS) slotq_init(&slots, buffer_size, sizeof(record_t), 0);
+    if (backend == BUF_SHARDS) shards_init(&shardset, consumers_count, buffer_size, shard_mode != SHARD_ORDERED);
 
-    sem_init(&empty, 0, buffer_size);   // initially all slots empty
-    sem_init(&full, 0, 0);              // initially no filled slots
-    pthread_mutex_init(&mutex, NULL);
-    pthread_mutex_init(&consumed_count_mutex, NULL);
+    sem_init(&prod.empty, 0, buffer_size);   // initially all slots empty
+    sem_init(&cons.full, 0, 0);              // initially no filled slots
+    pthread_mutex_init(&guard.mutex, NULL);
+    fsem_init(&prod.fempty, buffer_size);
+    fsem_init(&cons.ffull, 0);
+    fevcount_init(&prod.progress);
+    fmutex_init(&guard.fmutex);
 
     pthread_t *producers = malloc(sizeof(pthread_t) * producers_count);
     pthread_t *consumers = malloc(sizeof(pthread_t) * consumers_count);
@@ -189,19 +528,24 @@ int main(int argc, char *argv[]) {
         pthread_join(producers[i], NULL);
     }
     printf("All producers have finished.\n");
+    if (backend == BUF_SHARDS) shards_close(&shardset);   // consumers drain and leave
+    else close_items();
 
     // Wait for consumers to finish consuming all items
     for (int i = 0; i < consumers_count; ++i) {
         pthread_join(consumers[i], NULL);
     }
-    printf("All consumers have exited. Total consumed = %d (expected %d)\n", consumed_count, total_items);
+    printf("All consumers have exited. Total consumed = %d (expected %d)\n", atomic_load(&cons.consumed_count), total_items);
 
     // cleanup
-    sem_destroy(&empty);
-    sem_destroy(&full);
-    pthread_mutex_destroy(&mutex);
-    pthread_mutex_destroy(&consumed_count_mutex);
+    sem_destroy(&prod.empty);
+    sem_destroy(&cons.full);
+    pthread_mutex_destroy(&guard.mutex);
     buffer_destroy(&buffer);
+    if (backend == BUF_SPSC) spsc_destroy(&ring);
+    if (backend == BUF_MPMC) mpmc_destroy(&queue);
+    if (backend == BUF_SLOTS) slotq_destroy(&slots);
+    if (backend == BUF_SHARDS) shards_destroy(&shardset);
     free(producers);
     free(consumers);
 
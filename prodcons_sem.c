@@ -4,10 +4,14 @@
  * Producer-Consumer using counting semaphores + mutex (POSIX).
  *
  * Compile:
- *   gcc -o prodcons_sem prodcons_sem.c -pthread
+ *   gcc -O2 -o prodcons_sem prodcons_sem.c -pthread
+ *   (add -DCACHE_PACKED for the old layout, with no cache-line padding)
  *
  * Run:
- *   ./prodcons_sem <producers> <consumers> <buffer_size> <items_per_producer>
+ *   ./prodcons_sem <producers> <consumers> <buffer_size> <items_per_producer> [lock|futex|spsc|mpmc|shards|lanes] [strict|w0,w1]
+ *   ./prodcons_sem bench [max_threads] [items] [buffer_size] [batch] [work] [strict|w0,w1]
+ *   ./prodcons_sem grid [producers] [consumers] [buffer_sizes] [items] [work] [batch] [strict|w0,w1]
+ *   ./prodcons_sem records [record_bytes] [items] [producers] [consumers] [slots] [hugepages]
  *
  * Example:
  *   ./prodcons_sem 2 3 5 10
@@ -16,6 +20,59 @@
  *  - Each producer produces 'items_per_producer' integer items.
  *  - After producers finish, main inserts one poison pill (-1) per consumer.
  *  - Consumers exit when they read -1.
+ *  - The last argument picks the buffer: "lock" (default) is the circular
+ *    buffer below with two semaphores and a mutex; "futex" is the same
+ *    buffer with the spin-then-park semaphores and mutex from futex_sync.h
+ *    instead of sem_t and pthread_mutex_t; "spsc" is the lock-free
+ *    single-producer/single-consumer ring from ring.h (1 producer and
+ *    1 consumer only; main's poison pill comes after the producer joined,
+ *    so there is still one producer at a time); "mpmc" is the lock-free
+ *    bounded queue from ring.h, any number of producers and consumers;
+ *    "shards" gives each consumer a deque of its own (shard.h), with
+ *    buffer_size split between them. An item goes to the shard its value
+ *    hashes to (a batch to where its first item does) and idle consumers
+ *    steal from the tails of the others'. Instead of pills, main closes
+ *    the shards and get_item returns -1 once nothing is left. "lanes" is
+ *    two priority lanes (lanes.h): every 8th item by value is urgent and
+ *    goes to lane 0, with an eighth of buffer_size, the rest to the bulk
+ *    lane. Each lane blocks its own producers when full. Consumers take
+ *    urgent items first ("strict", the default) or by weighted round
+ *    robin, w0 urgent then w1 bulk items per turn ("4,1"). Main closes
+ *    the lanes, as with shards.
+ *
+ * "bench" drops the sleeps and prints and moves 'items' items through
+ * the buffer with P producers and P consumers, P = 1, 2, 4 .. max_threads
+ * (default 64), and prints items per second for every buffer. With a
+ * batch > 1 producers hand over 'batch' items per call (put_items) and
+ * consumers take everything available, up to 'batch', per call
+ * (get_items). On the lock buffer a batch costs one sem_wait, one
+ * lock/unlock and one or two memcpy's; the rest of the semaphore counts
+ * are taken with sem_trywait and given back with sem_post, which stay in
+ * user space while nobody sleeps (sem_t has no wait-for-n). The futex
+ * buffer takes and gives back all of a batch's units in one go.
+ *
+ * "grid" runs every backend for every combination of the comma-separated
+ * producer counts, consumer counts and buffer sizes (defaults 1,4,16 /
+ * 1,4,16 / 16,1024; 1000000 items) and prints items per second and the
+ * p50 / p99 / p99.9 / max time from just before an item's put to just
+ * after its get. Timestamps are TSC reads (latency.h) kept in a side
+ * array indexed by the item, and every consumer fills its own histogram.
+ * 'work' (both modes) is that many rounds of busy_work per item on each
+ * side, to see how the buffers behave when producing and consuming cost
+ * something; with 0 the numbers are the cost of the buffer alone.
+ * "bench" takes no timestamps: two TSC reads and a stamp per item are
+ * tens of ns, a large share of what the lock-free buffers cost. Where
+ * the CPU's cache-miss counter can be read (cacheline.h; not in most
+ * VMs), grid also prints cache misses per item. For "lanes" it adds a
+ * row per lane with its item count and latency percentiles.
+ *
+ * "records" moves records of record_bytes (default 4096, up to 64 KB)
+ * through slotq_t from ring.h, twice: with put/get, where the producer
+ * builds a record in its own memory and it is copied into the slot and
+ * out again, and with claim/commit, where the producer writes it into
+ * the slot and the consumer reads it there. A record is 8-byte words;
+ * the producers' and consumers' checksums must match. hugepages = 1
+ * puts the slots on huge pages.
  */
 
 #include <stdio.h>
@@ -23,24 +80,70 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include "futex_sync.h"
+#include "ring.h"
+#include "latency.h"
+#include "cacheline.h"
+#include "shard.h"
+#include "lanes.h"
 
 typedef int item_t;
 
-/* circular buffer */
+/* circular buffer; in and out each on a cache line of their own */
 typedef struct {
-    item_t *buf;
+    item_t *buf;              // read-only after init
     int capacity;
-    int in;   // next insertion index
-    int out;  // next removal index
+    CACHE_ALIGNED int in;     // next insertion index (producers)
+    CACHE_ALIGNED int out;    // next removal index (consumers)
 } buffer_t;
 
 buffer_t buffer;
-sem_t empty;              // counts free slots
-sem_t full;               // counts filled slots
-pthread_mutex_t mutex;    // protects buffer access
+
+/* Shared state in cache-line regions (cacheline.h): producers wait on
+   empty and consumers on full, and both take the lock, so each gets a
+   line to itself and the read-only settings below share none of them */
+struct {
+    CACHE_ALIGNED sem_t empty;        // counts free slots
+    fsem_t fempty;                    // BUF_FUTEX: the same, futex_sync.h
+} prod;
+
+struct {
+    CACHE_ALIGNED sem_t full;         // counts filled slots
+    fsem_t ffull;
+} cons;
+
+struct {
+    CACHE_ALIGNED pthread_mutex_t mutex;  // protects buffer access
+    fmutex_t fmutex;
+} guard;
 
 int producers_count, consumers_count, items_per_producer;
 
+enum { BUF_LOCK, BUF_FUTEX, BUF_SPSC, BUF_MPMC, BUF_SHARDS, BUF_LANES };
+const char *buffer_names[] = { "lock", "futex", "spsc", "mpmc", "shards", "lanes" };
+int backend = BUF_LOCK;
+spsc_ring_t ring;         // BUF_SPSC: 1 producer, 1 consumer
+mpmc_queue_t queue;       // BUF_MPMC
+shardset_t shardset;      // BUF_SHARDS: one shard per consumer
+_Thread_local int shard_self;   // BUF_SHARDS: the calling consumer's shard
+_Thread_local int shard_last;   // BUF_SHARDS: where this thread put last
+
+/* BUF_LANES: every URGENT_EVERY-th item (by value) is urgent (lane 0),
+   the rest bulk (lane 1) */
+#define LANES        2
+#define URGENT_EVERY 8
+lanes_t lanes;
+int lane_weight[LANES];         // items per turn; all 0 = strict priority
+const char *lane_names[] = { "urgent", "bulk" };
+_Thread_local int lane_last;    // lane of this thread's last put or get
+
+int item_lane(item_t x) {
+    return x % URGENT_EVERY == 0 ? 0 : 1;
+}
+
 /* initialize buffer */
 void buffer_init(buffer_t *b, int capacity) {
     b->buf = malloc(sizeof(item_t) * capacity);
@@ -67,17 +170,239 @@ item_t buffer_get(buffer_t *b) {
     return x;
 }
 
+/* put n items in one run, wrapping around the end (caller synchronizes) */
+void buffer_put_n(buffer_t *b, const item_t *x, int n) {
+    int first = b->capacity - b->in < n ? b->capacity - b->in : n;
+    memcpy(b->buf + b->in, x, first * sizeof(item_t));
+    memcpy(b->buf, x + first, (n - first) * sizeof(item_t));
+    b->in = (b->in + n) % b->capacity;
+}
+
+/* get n items in one run, wrapping around the end (caller synchronizes) */
+void buffer_get_n(buffer_t *b, item_t *x, int n) {
+    int first = b->capacity - b->out < n ? b->capacity - b->out : n;
+    memcpy(x, b->buf + b->out, first * sizeof(item_t));
+    memcpy(x + first, b->buf, (n - first) * sizeof(item_t));
+    b->out = (b->out + n) % b->capacity;
+}
+
+/* wait for one unit of s, then take up to max - 1 more without blocking */
+int sem_wait_n(sem_t *s, int max) {
+    int n = 1;
+    sem_wait(s);
+    while (n < max && sem_trywait(s) == 0) n++;
+    return n;
+}
+
+void sem_post_n(sem_t *s, int n) {
+    while (n-- > 0) sem_post(s);
+}
+
+/* put / get through whichever buffer is in use */
+void put_item(item_t x) {
+    if (backend == BUF_LANES) {
+        lane_last = item_lane(x);
+        lanes_put_n(&lanes, lane_last, &x, 1);
+        return;
+    }
+    if (backend == BUF_SHARDS) {
+        shard_last = shards_pick_key(&shardset, x);
+        shards_put(&shardset, shard_last, x);
+        return;
+    }
+    if (backend == BUF_SPSC) {
+        spsc_put(&ring, x);
+        return;
+    }
+    if (backend == BUF_MPMC) {
+        mpmc_put(&queue, x);
+        return;
+    }
+    if (backend == BUF_FUTEX) {
+        fsem_wait(&prod.fempty);
+        fmutex_lock(&guard.fmutex);
+        buffer_put(&buffer, x);
+        fmutex_unlock(&guard.fmutex);
+        fsem_post(&cons.ffull);
+        return;
+    }
+    sem_wait(&prod.empty);                // wait for free slot
+    pthread_mutex_lock(&guard.mutex);     // enter critical section
+    buffer_put(&buffer, x);
+    pthread_mutex_unlock(&guard.mutex);   // leave critical section
+    sem_post(&cons.full);                 // signal filled slot
+}
+
+item_t get_item(void) {
+    if (backend == BUF_LANES) {
+        item_t x;
+        if (lanes_get_n(&lanes, &x, 1) == 0) return -1;   // closed and drained
+        lane_last = item_lane(x);
+        return x;
+    }
+    if (backend == BUF_SHARDS) {
+        item_t x;
+        return shards_get_n(&shardset, shard_self, &x, 1) ? x : -1;   // -1 once closed and drained
+    }
+    if (backend == BUF_SPSC) return spsc_get(&ring);
+    if (backend == BUF_MPMC) return mpmc_get(&queue);
+    if (backend == BUF_FUTEX) {
+        fsem_wait(&cons.ffull);
+        fmutex_lock(&guard.fmutex);
+        item_t x = buffer_get(&buffer);
+        fmutex_unlock(&guard.fmutex);
+        fsem_post(&prod.fempty);
+        return x;
+    }
+    sem_wait(&cons.full);                 // wait for a filled slot
+    pthread_mutex_lock(&guard.mutex);     // enter critical section
+    item_t x = buffer_get(&buffer);
+    pthread_mutex_unlock(&guard.mutex);   // leave critical section
+    sem_post(&prod.empty);                // signal free slot
+    return x;
+}
+
+/* put all n items, a run at a time */
+void put_items(const item_t *x, int n) {
+    if (backend == BUF_LANES) {
+        // one put per run of items bound for the same lane
+        for (int i = 0, j; i < n; i = j) {
+            for (j = i + 1; j < n && item_lane(x[j]) == item_lane(x[i]); ++j) {}
+            lanes_put_n(&lanes, item_lane(x[i]), x + i, j - i);
+        }
+        return;
+    }
+    if (backend == BUF_SHARDS) {
+        shard_last = shards_pick_key(&shardset, x[0]);   // the run goes where its first item hashes
+        shards_put_n(&shardset, shard_last, x, n);
+        return;
+    }
+    if (backend == BUF_SPSC) {
+        spsc_put_n(&ring, x, n);
+        return;
+    }
+    if (backend == BUF_MPMC) {
+        mpmc_put_n(&queue, x, n);
+        return;
+    }
+    while (n > 0) {
+        int k;
+        if (backend == BUF_FUTEX) {
+            k = fsem_wait_n(&prod.fempty, n);
+            fmutex_lock(&guard.fmutex);
+            buffer_put_n(&buffer, x, k);
+            fmutex_unlock(&guard.fmutex);
+            fsem_post_n(&cons.ffull, k);
+        } else {
+            k = sem_wait_n(&prod.empty, n); // wait for free slots
+            pthread_mutex_lock(&guard.mutex);
+            buffer_put_n(&buffer, x, k);
+            pthread_mutex_unlock(&guard.mutex);
+            sem_post_n(&cons.full, k);      // signal filled slots
+        }
+        x += k;
+        n -= k;
+    }
+}
+
+/* wait for at least one item, then take all that are there, up to max */
+int get_items(item_t *x, int max) {
+    if (backend == BUF_LANES) {
+        int n = lanes_get_n(&lanes, x, max);
+        if (n == 0) x[n++] = -1;
+        return n;
+    }
+    if (backend == BUF_SHARDS) {
+        int n = shards_get_n(&shardset, shard_self, x, max);
+        if (n == 0) x[n++] = -1;
+        return n;
+    }
+    if (backend == BUF_SPSC) return spsc_get_n(&ring, x, max);
+    if (backend == BUF_MPMC) return mpmc_get_n(&queue, x, max);
+    if (backend == BUF_FUTEX) {
+        int n = fsem_wait_n(&cons.ffull, max);
+        fmutex_lock(&guard.fmutex);
+        buffer_get_n(&buffer, x, n);
+        fmutex_unlock(&guard.fmutex);
+        fsem_post_n(&prod.fempty, n);
+        return n;
+    }
+    int n = sem_wait_n(&cons.full, max);  // wait for filled slots
+    pthread_mutex_lock(&guard.mutex);
+    buffer_get_n(&buffer, x, n);
+    pthread_mutex_unlock(&guard.mutex);
+    sem_post_n(&prod.empty, n);           // signal free slots
+    return n;
+}
+
+/* slot index for the log lines */
+int in_index(void) {
+    if (backend == BUF_LANES) return lane_last;
+    if (backend == BUF_SHARDS) return shard_last;
+    if (backend == BUF_SPSC) return (int) (atomic_load(&ring.tail) & ring.mask);
+    if (backend == BUF_MPMC) return (int) (atomic_load(&queue.enqueue_pos) & queue.mask);
+    return buffer.in;
+}
+
+int out_index(void) {
+    if (backend == BUF_LANES) return lane_last;
+    if (backend == BUF_SHARDS) return shards_from;
+    if (backend == BUF_SPSC) return (int) (atomic_load(&ring.head) & ring.mask);
+    if (backend == BUF_MPMC) return (int) (atomic_load(&queue.dequeue_pos) & queue.mask);
+    return buffer.out;
+}
+
+void buffers_init(int buffer_size) {
+    buffer_init(&buffer, buffer_size);
+    if (backend == BUF_SPSC) spsc_init(&ring, buffer_size);
+    if (backend == BUF_MPMC) mpmc_init(&queue, buffer_size);
+    if (backend == BUF_SHARDS)   // the same room in total, split over the consumers
+        shards_init(&shardset, consumers_count,
+                    buffer_size > consumers_count ? buffer_size / consumers_count : 1, 1);
+    if (backend == BUF_LANES) {  // the same room in total, an eighth of it urgent
+        int urgent = buffer_size >= 2 * URGENT_EVERY ? buffer_size / URGENT_EVERY : 1;
+        int capacity[LANES] = { urgent, buffer_size > urgent ? buffer_size - urgent : 1 };
+        lanes_init(&lanes, LANES, capacity, lane_weight[0] ? lane_weight : NULL);
+    }
+    sem_init(&prod.empty, 0, buffer_size);
+    sem_init(&cons.full, 0, 0);
+    pthread_mutex_init(&guard.mutex, NULL);
+    fsem_init(&prod.fempty, buffer_size);
+    fsem_init(&cons.ffull, 0);
+    fmutex_init(&guard.fmutex);
+}
+
+void buffers_destroy(void) {
+    sem_destroy(&prod.empty);
+    sem_destroy(&cons.full);
+    pthread_mutex_destroy(&guard.mutex);
+    buffer_destroy(&buffer);
+    if (backend == BUF_SPSC) spsc_destroy(&ring);
+    if (backend == BUF_MPMC) mpmc_destroy(&queue);
+    if (backend == BUF_SHARDS) shards_destroy(&shardset);
+    if (backend == BUF_LANES) lanes_destroy(&lanes);
+}
+
+/* no more items: one poison pill per consumer, or close the shards / lanes */
+void end_items(void) {
+    if (backend == BUF_SHARDS) {
+        shards_close(&shardset);
+        return;
+    }
+    if (backend == BUF_LANES) {
+        lanes_close(&lanes);
+        return;
+    }
+    for (int i = 0; i < consumers_count; ++i) put_item(-1);
+}
+
 void *producer(void *arg) {
     long id = (long) arg;
     for (int i = 1; i <= items_per_producer; ++i) {
         item_t it = (int)(id * 100000 + i); // encode producer id and seq for clarity
 
-        sem_wait(&empty);                 // wait for free slot
-        pthread_mutex_lock(&mutex);       // enter critical section
-        buffer_put(&buffer, it);
-        printf("[Producer %ld] produced %d (in=%d)\n", id, it, buffer.in);
-        pthread_mutex_unlock(&mutex);     // leave critical section
-        sem_post(&full);                  // signal filled slot
+        put_item(it);
+        printf("[Producer %ld] produced %d (in=%d)\n", id, it, in_index());
 
         // simulate work
         usleep((rand() % 200 + 50) * 1000);
@@ -88,12 +413,9 @@ void *producer(void *arg) {
 
 void *consumer(void *arg) {
     long id = (long) arg;
+    shard_self = (int) id;
     while (1) {
-        sem_wait(&full);                  // wait for a filled slot
-        pthread_mutex_lock(&mutex);       // enter critical section
-        item_t it = buffer_get(&buffer);
-        pthread_mutex_unlock(&mutex);     // leave critical section
-        sem_post(&empty);                 // signal free slot
+        item_t it = get_item();
 
         if (it == -1) {
             // poison pill: re-insert for other consumers if multiple consumers read fast
@@ -105,7 +427,7 @@ void *consumer(void *arg) {
         // process item
         int prod = it / 100000;
         int seq  = it % 100000;
-        printf("[Consumer %ld] consumed item from P%d seq=%d (out=%d)\n", id, prod, seq, buffer.out);
+        printf("[Consumer %ld] consumed item from P%d seq=%d (out=%d)\n", id, prod, seq, out_index());
 
         // simulate processing
         usleep((rand() % 200 + 50) * 1000);
@@ -113,9 +435,376 @@ void *consumer(void *arg) {
     return NULL;
 }
 
+/* bench / grid: no sleeps, no prints */
+#define MAX_BATCH   4096
+#define MAX_THREADS 64
+#define MAX_GRID    16   // values per grid axis
+
+int batch = 1;           // items per put_items / most items per get_items
+int work = 0;            // rounds of busy_work per item, on both sides
+uint64_t *stamp;         // stamp[item]: lat_now() just before the put (grid only)
+_Atomic uint64_t bench_sink;
+double misses_per_item;  // cache misses of the last bench_run, -1 without a counter
+lat_hist_t lane_lat[LANES];   // latency per lane of the last bench_run, BUF_LANES
+
+// One per consumer, on lines of its own: every item bumps items
+typedef struct {
+    CACHE_ALIGNED lat_hist_t hist;   // enqueue -> dequeue, ns
+    lat_hist_t lane_hist[LANES];     // the same per lane, BUF_LANES
+    long items;
+    int id;
+} bench_consumer_t;
+
+// Synthetic per-item work the compiler cannot drop (an LCG step per round)
+uint64_t busy_work(uint64_t x, int rounds) {
+    for (int i = 0; i < rounds; ++i) x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return x;
+}
+
+void *bench_producer(void *arg) {
+    int first = (int) (long) arg * items_per_producer;   // items are global ids
+    uint64_t x = 0;
+    item_t *run = malloc(sizeof(item_t) * batch);
+    for (int i = 0; i < items_per_producer; ) {
+        int k = 0;
+        while (k < batch && i < items_per_producer) {
+            x = busy_work(x, work);
+            run[k++] = first + i++;
+        }
+        if (stamp) {
+            uint64_t now = lat_now();
+            for (int j = 0; j < k; ++j) stamp[run[j]] = now;
+        }
+        if (k == 1) put_item(run[0]);
+        else put_items(run, k);
+    }
+    free(run);
+    atomic_fetch_add(&bench_sink, x);
+    return NULL;
+}
+
+void *bench_consumer(void *arg) {
+    bench_consumer_t *c = arg;
+    uint64_t x = 0;
+    shard_self = c->id;
+    item_t *run = malloc(sizeof(item_t) * batch);
+    for (int pills = 0; pills == 0; ) {
+        int k;
+        if (batch == 1) {
+            run[0] = get_item();
+            k = 1;
+        } else {
+            k = get_items(run, batch);
+        }
+        uint64_t now = stamp ? lat_now() : 0;
+        for (int i = 0; i < k; ++i) {
+            if (run[i] == -1) {
+                pills++;
+                continue;
+            }
+            if (stamp) {
+                uint64_t ns = lat_ns(now - stamp[run[i]]);
+                lat_add(&c->hist, ns);
+                if (backend == BUF_LANES) lat_add(&c->lane_hist[item_lane(run[i])], ns);
+            }
+            x = busy_work(x, work);
+            c->items++;
+        }
+        // the pills come after every item; leave the others' pills behind
+        for (int i = 1; i < pills; ++i) put_item(-1);
+    }
+    free(run);
+    atomic_fetch_add(&bench_sink, x);
+    return NULL;
+}
+
+// One run with the current backend. Returns items per second (-1 if
+// items got lost) and the merged latency histogram in *hist, and sets
+// misses_per_item.
+double bench_run(int producers, int consumers, int items, int buffer_size, lat_hist_t *hist) {
+    producers_count = producers;
+    consumers_count = consumers;
+    items_per_producer = items / producers;
+    buffers_init(buffer_size);
+    bench_consumer_t *stats = cache_alloc(sizeof(bench_consumer_t) * consumers);
+    for (int i = 0; i < consumers; ++i) {
+        lat_init(&stats[i].hist);
+        for (int l = 0; l < LANES; ++l) lat_init(&stats[i].lane_hist[l]);
+        stats[i].items = 0;
+        stats[i].id = i;
+    }
+
+    pthread_t t[2 * MAX_THREADS];
+    struct timespec t0, t1;
+    int counter = cache_misses_open();
+    uint64_t misses = counter >= 0 ? cache_misses_read(counter) : 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < consumers; ++i) pthread_create(&t[producers + i], NULL, bench_consumer, &stats[i]);
+    for (long i = 0; i < producers; ++i) pthread_create(&t[i], NULL, bench_producer, (void *) i);
+    for (int i = 0; i < producers; ++i) pthread_join(t[i], NULL);
+    end_items();
+    for (int i = 0; i < consumers; ++i) pthread_join(t[producers + i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    misses_per_item = -1;
+    if (counter >= 0) {
+        misses_per_item = (double) (cache_misses_read(counter) - misses) / items;
+        close(counter);
+    }
+    buffers_destroy();
+
+    long got = 0;
+    lat_init(hist);
+    for (int l = 0; l < LANES; ++l) lat_init(&lane_lat[l]);
+    for (int i = 0; i < consumers; ++i) {
+        got += stats[i].items;
+        lat_merge(hist, &stats[i].hist);
+        for (int l = 0; l < LANES; ++l) lat_merge(&lane_lat[l], &stats[i].lane_hist[l]);
+    }
+    free(stats);
+    if (got != (long) items_per_producer * producers) return -1;
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    return got / secs;
+}
+
+// P producers and P consumers, P = 1, 2, 4 .. max_threads: items/s
+int bench(int max_threads, int items, int buffer_size) {
+    lat_hist_t *hist = malloc(sizeof(lat_hist_t));
+    printf("%d items, buffer %d, batch %d, work %d, P producers + P consumers (items/s)\n",
+           items, buffer_size, batch, work);
+    printf("%4s", "P");
+    for (int b = BUF_LOCK; b <= BUF_LANES; ++b) printf(" %14s", buffer_names[b]);
+    printf("\n");
+    for (int p = 1; p <= max_threads; p *= 2) {
+        printf("%4d", p);
+        for (backend = BUF_LOCK; backend <= BUF_LANES; ++backend) {
+            if (backend == BUF_SPSC && p != 1) {
+                printf(" %14s", "-");
+                continue;
+            }
+            double rate = bench_run(p, p, items, buffer_size, hist);
+            if (rate < 0) {
+                printf("\n%s lost items with %d threads\n", buffer_names[backend], p);
+                return 1;
+            }
+            printf(" %14.0f", rate);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    free(hist);
+    return 0;
+}
+
+// Every producers x consumers x buffer size, every backend: items/s
+// and enqueue-to-dequeue latency percentiles
+int grid(const int *ps, int np, const int *cs, int nc, const int *bs, int nb, int items) {
+    lat_hist_t *hist = malloc(sizeof(lat_hist_t));
+    printf("%d items, batch %d, work %d; latency is enqueue -> dequeue in ns\n", items, batch, work);
+    printf("%-6s %4s %4s %7s %12s %9s %9s %9s %9s %10s\n",
+           "buffer", "P", "C", "size", "items/s", "p50", "p99", "p99.9", "max", "miss/item");
+    for (int ib = 0; ib < nb; ++ib)
+    for (int ip = 0; ip < np; ++ip)
+    for (int ic = 0; ic < nc; ++ic)
+    for (backend = BUF_LOCK; backend <= BUF_LANES; ++backend) {
+        if (backend == BUF_SPSC && (ps[ip] != 1 || cs[ic] != 1)) continue;
+        double rate = bench_run(ps[ip], cs[ic], items, bs[ib], hist);
+        if (rate < 0) {
+            printf("%s lost items with %d producers, %d consumers\n", buffer_names[backend], ps[ip], cs[ic]);
+            return 1;
+        }
+        printf("%-6s %4d %4d %7d %12.0f %9lu %9lu %9lu %9lu", buffer_names[backend],
+               ps[ip], cs[ic], bs[ib], rate,
+               (unsigned long) lat_percentile(hist, 0.50), (unsigned long) lat_percentile(hist, 0.99),
+               (unsigned long) lat_percentile(hist, 0.999), (unsigned long) hist->max);
+        if (misses_per_item < 0) printf(" %10s\n", "-");
+        else printf(" %10.2f\n", misses_per_item);
+        for (int l = 0; backend == BUF_LANES && l < LANES; ++l) {
+            printf("  %-10s %18lu items %9lu %9lu %9lu %9lu\n", lane_names[l],
+                   (unsigned long) lane_lat[l].n,
+                   (unsigned long) lat_percentile(&lane_lat[l], 0.50),
+                   (unsigned long) lat_percentile(&lane_lat[l], 0.99),
+                   (unsigned long) lat_percentile(&lane_lat[l], 0.999), (unsigned long) lane_lat[l].max);
+        }
+        fflush(stdout);
+    }
+    free(hist);
+    return 0;
+}
+
+// "1,4,16" -> {1, 4, 16}; returns the count, 0 if malformed
+int parse_list(const char *s, int *v, int max, int limit) {
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        long x = strtol(s, &end, 10);
+        if (end == s || x <= 0 || x > limit) return 0;
+        v[n++] = (int) x;
+        s = (*end == ',') ? end + 1 : end;
+        if (*end && *end != ',') return 0;
+    }
+    return *s ? 0 : n;
+}
+
+// Lane policy: "strict", or one weight per lane ("4,1"); returns 0 if malformed
+int parse_lanes(const char *s) {
+    if (strcmp(s, "strict") == 0) {
+        memset(lane_weight, 0, sizeof lane_weight);
+        return 1;
+    }
+    return parse_list(s, lane_weight, LANES, 1 << 20) == LANES;
+}
+
+/* records: large items through slotq_t, copied vs in place */
+slotq_t slots;
+int record_size, zero_copy;
+_Atomic uint64_t sum_written, sum_read;
+
+// Write one record (8-byte words) and return its checksum
+uint64_t fill_record(uint64_t *w, size_t words, uint64_t seed) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < words; ++i) sum += (w[i] = seed + i);
+    return sum;
+}
+
+uint64_t read_record(const uint64_t *w, size_t words) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < words; ++i) sum += w[i];
+    return sum;
+}
+
+void *record_producer(void *arg) {
+    long id = (long) arg;
+    size_t words = record_size / 8;
+    uint64_t *local = cache_alloc(record_size), sum = 0;
+    for (int i = 0; i < items_per_producer; ++i) {
+        uint64_t seed = (uint64_t) id << 32 | i;
+        if (zero_copy) {
+            slot_t s;
+            slotq_claim(&slots, &s);
+            sum += fill_record(s.data, words, seed);
+            slotq_commit(&slots, &s, words * 8);
+        } else {
+            sum += fill_record(local, words, seed);
+            slotq_put(&slots, local, words * 8);
+        }
+    }
+    free(local);
+    atomic_fetch_add(&sum_written, sum);
+    return NULL;
+}
+
+void *record_consumer(void *arg) {
+    uint64_t *local = cache_alloc(record_size), sum = 0;
+    (void) arg;
+    for (;;) {
+        size_t len;
+        if (zero_copy) {
+            slot_t s;
+            slotq_acquire(&slots, &s);
+            len = s.len;
+            sum += read_record(s.data, len / 8);
+            slotq_release(&slots, &s);
+        } else {
+            len = slotq_get(&slots, local);
+            sum += read_record(local, len / 8);
+        }
+        if (len == 0) break;   // empty record: end of stream
+    }
+    free(local);
+    atomic_fetch_add(&sum_read, sum);
+    return NULL;
+}
+
+int records(int size, int items, int producers, int consumers, int nslots, int huge) {
+    record_size = size;
+    items_per_producer = items / producers;
+    long total = (long) items_per_producer * producers;
+    for (zero_copy = 0; zero_copy <= 1; ++zero_copy) {
+        slotq_init(&slots, nslots, size, huge);
+        atomic_store(&sum_written, 0);
+        atomic_store(&sum_read, 0);
+
+        pthread_t t[2 * MAX_THREADS];
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < consumers; ++i) pthread_create(&t[producers + i], NULL, record_consumer, NULL);
+        for (long i = 0; i < producers; ++i) pthread_create(&t[i], NULL, record_producer, (void *) i);
+        for (int i = 0; i < producers; ++i) pthread_join(t[i], NULL);
+        for (int i = 0; i < consumers; ++i) slotq_put(&slots, NULL, 0);
+        for (int i = 0; i < consumers; ++i) pthread_join(t[producers + i], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        if (zero_copy == 0)
+            printf("%ld records of %d bytes, %d producers, %d consumers, %d slots (%s)\n",
+                   total, size, producers, consumers, slots.capacity,
+                   slots.huge == 1 ? "MAP_HUGETLB" : slots.huge == 2 ? "transparent huge pages" : "4 KB pages");
+        slotq_destroy(&slots);
+        if (atomic_load(&sum_read) != atomic_load(&sum_written)) {
+            printf("%s: checksums differ\n", zero_copy ? "claim/commit" : "put/get");
+            return 1;
+        }
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        printf("%-13s %12.0f records/s %8.2f GB/s\n", zero_copy ? "claim/commit" : "put/get copy",
+               total / secs, total * (double) size / secs / 1e9);
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <producers> <consumers> <buffer_size> <items_per_producer>\n", argv[0]);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int max_threads = (argc > 2) ? atoi(argv[2]) : 64;
+        int items = (argc > 3) ? atoi(argv[3]) : 2000000;
+        int buffer_size = (argc > 4) ? atoi(argv[4]) : 1024;
+        batch = (argc > 5) ? atoi(argv[5]) : 1;
+        work = (argc > 6) ? atoi(argv[6]) : 0;
+        int lanes_ok = parse_lanes((argc > 7) ? argv[7] : "strict");
+        if (max_threads <= 0 || max_threads > MAX_THREADS || items < max_threads || buffer_size <= 0 ||
+            batch <= 0 || batch > MAX_BATCH || work < 0 || !lanes_ok) {
+            fprintf(stderr, "Usage: %s bench [max_threads<=%d] [items] [buffer_size] [batch<=%d] [work] [strict|w0,w1]\n",
+                    argv[0], MAX_THREADS, MAX_BATCH);
+            return 1;
+        }
+        return bench(max_threads, items, buffer_size);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "records") == 0) {
+        int size = (argc > 2) ? atoi(argv[2]) : 4096;
+        int items = (argc > 3) ? atoi(argv[3]) : 200000;
+        int producers = (argc > 4) ? atoi(argv[4]) : 1;
+        int consumers = (argc > 5) ? atoi(argv[5]) : 1;
+        int nslots = (argc > 6) ? atoi(argv[6]) : 64;
+        int huge = (argc > 7) ? atoi(argv[7]) : 0;
+        if (size < 8 || size > (64 << 10) || items <= 0 || producers <= 0 || producers > MAX_THREADS ||
+            consumers <= 0 || consumers > MAX_THREADS || items < producers || nslots <= 0) {
+            fprintf(stderr, "Usage: %s records [record_bytes 8..65536] [items] [producers] [consumers] [slots] [hugepages 0|1]\n",
+                    argv[0]);
+            return 1;
+        }
+        return records(size, items, producers, consumers, nslots, huge);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "grid") == 0) {
+        int ps[MAX_GRID], cs[MAX_GRID], bs[MAX_GRID];
+        int np = parse_list((argc > 2) ? argv[2] : "1,4,16", ps, MAX_GRID, MAX_THREADS);
+        int nc = parse_list((argc > 3) ? argv[3] : "1,4,16", cs, MAX_GRID, MAX_THREADS);
+        int nb = parse_list((argc > 4) ? argv[4] : "16,1024", bs, MAX_GRID, 1 << 24);
+        int items = (argc > 5) ? atoi(argv[5]) : 1000000;
+        work = (argc > 6) ? atoi(argv[6]) : 0;
+        batch = (argc > 7) ? atoi(argv[7]) : 1;
+        int lanes_ok = parse_lanes((argc > 8) ? argv[8] : "strict");
+        if (np == 0 || nc == 0 || nb == 0 || items < MAX_THREADS || work < 0 || batch <= 0 || batch > MAX_BATCH ||
+            !lanes_ok) {
+            fprintf(stderr, "Usage: %s grid [producers,..] [consumers,..] [buffer_sizes,..] [items] [work] [batch<=%d] [strict|w0,w1]\n",
+                    argv[0], MAX_BATCH);
+            return 1;
+        }
+        lat_calibrate();
+        stamp = malloc(sizeof(uint64_t) * items);
+        return grid(ps, np, cs, nc, bs, nb, items);
+    }
+
+    if (argc < 5 || argc > 7) {
+        fprintf(stderr, "Usage: %s <producers> <consumers> <buffer_size> <items_per_producer> [lock|futex|spsc|mpmc|shards|lanes] [strict|w0,w1]\n", argv[0]);
         return 1;
     }
 
@@ -129,11 +818,24 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (argc >= 6) {
+        for (backend = BUF_LANES; backend >= 0 && strcmp(argv[5], buffer_names[backend]) != 0; --backend) {}
+        if (backend < 0) {
+            fprintf(stderr, "Buffer must be lock, futex, spsc, mpmc, shards or lanes.\n");
+            return 1;
+        }
+        if (!parse_lanes((argc > 6) ? argv[6] : "strict")) {
+            fprintf(stderr, "Lane policy must be strict or %d weights, e.g. 4,1.\n", LANES);
+            return 1;
+        }
+        if (backend == BUF_SPSC && (producers_count != 1 || consumers_count != 1)) {
+            fprintf(stderr, "spsc needs exactly 1 producer and 1 consumer.\n");
+            return 1;
+        }
+    }
+
     srand((unsigned)time(NULL));
-    buffer_init(&buffer, buffer_size);
-    sem_init(&empty, 0, buffer_size);
-    sem_init(&full, 0, 0);
-    pthread_mutex_init(&mutex, NULL);
+    buffers_init(buffer_size);
 
     pthread_t *producers = malloc(sizeof(pthread_t) * producers_count);
     pthread_t *consumers = malloc(sizeof(pthread_t) * consumers_count);
@@ -156,26 +858,28 @@ int main(int argc, char *argv[]) {
 
     // wait for producers to finish
     for (int i = 0; i < producers_count; ++i) pthread_join(producers[i], NULL);
-    printf("Main: all producers finished — inserting poison pills for consumers.\n");
+    printf("Main: all producers finished.\n");
 
-    // insert one poison pill (-1) per consumer so they exit
-    for (int i = 0; i < consumers_count; ++i) {
-        sem_wait(&empty);
-        pthread_mutex_lock(&mutex);
-        buffer_put(&buffer, -1);
-        printf("[Main] inserted poison pill (in=%d)\n", buffer.in);
-        pthread_mutex_unlock(&mutex);
-        sem_post(&full);
+    if (backend == BUF_SHARDS) {
+        shards_close(&shardset);      // get_item returns -1 once nothing is left
+        printf("[Main] closed the shards\n");
+    } else if (backend == BUF_LANES) {
+        lanes_close(&lanes);
+        printf("[Main] closed the lanes\n");
+    } else {
+        // insert one poison pill (-1) per consumer so they exit
+        printf("Main: inserting poison pills for consumers.\n");
+        for (int i = 0; i < consumers_count; ++i) {
+            put_item(-1);
+            printf("[Main] inserted poison pill (in=%d)\n", in_index());
+        }
     }
 
     // wait for consumers to finish
     for (int i = 0; i < consumers_count; ++i) pthread_join(consumers[i], NULL);
 
     // cleanup
-    sem_destroy(&empty);
-    sem_destroy(&full);
-    pthread_mutex_destroy(&mutex);
-    buffer_destroy(&buffer);
+    buffers_destroy();
     free(producers);
     free(consumers);
 
@@ -0,0 +1,664 @@
+/*
+ * ring.h
+ *
+ * Lock-free bounded buffers for the producer-consumer programs.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "ring.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * spsc_ring_t: one producer thread, one consumer thread.
+ *   The producer owns tail and the consumer owns head; each is written by
+ *   one thread only and published with a release store, and the other
+ *   side reads it with an acquire load. Each side also keeps a private
+ *   copy of the other side's index and re-reads the shared one only when
+ *   the copy says full (or empty). The two sides live on separate cache
+ *   lines, so an item costs no lock and, most of the time, no cache line
+ *   bouncing beyond the slot itself. Capacity is rounded up to a power
+ *   of two, so the indices run freely and a slot is index & mask.
+ *
+ *   A side only blocks when the ring really is full (or empty): it polls
+ *   for a while on SMP, then sleeps on a futex. Before sleeping it sets
+ *   its flag and looks at the index once more; the other side stores its
+ *   index and then looks at the flag (both sequentially consistent), so
+ *   one of the two always sees the other and no wake-up is lost.
+ *
+ * mpmc_queue_t: any number of producers and consumers (D. Vyukov's
+ *   bounded queue). Every cell carries a sequence number that says whose
+ *   turn it is: seq == pos means free for the producer that claims
+ *   position pos, seq == pos + 1 means filled for the consumer that
+ *   claims pos. Claiming a position is one CAS on enqueue_pos or
+ *   dequeue_pos. Producers and consumers never touch the same counter,
+ *   and there is no lock to queue behind.
+ *
+ *   Blocking: each direction has an event counter (fevcount_t from
+ *   futex_sync.h). A sleeper reads the counter, registers, tries once
+ *   more and only then sleeps; the other side publishes its cell, fences,
+ *   and wakes one thread only if a registered sleeper has no wake on the
+ *   way yet. An uncontended put or get is one CAS and one fence.
+ *
+ * Batches: the _n variants move a run of items for one claim and one
+ *   publish. spsc_put_n / mpmc_put_n put all n items (blocking while the
+ *   buffer is full) and spsc_get_n / mpmc_get_n wait for at least one item
+ *   and then take everything available, up to max. In the SPSC ring a
+ *   batch is one index store and one or two memcpy's (the run may wrap);
+ *   in the MPMC queue it is one CAS over a run of ready cells, and each
+ *   cell is still published with its own sequence number.
+ *
+ * slotq_t: the MPMC queue's protocol over slots of any size (records of
+ *   a few bytes up to many KB), with no copy on either side. A producer
+ *   claims a slot, writes its record in place and commits it; a consumer
+ *   acquires a slot, reads the record in place and releases it. The
+ *   sequence number and length sit in a 64-byte header in front of
+ *   every payload, so payloads are cache-line aligned and a slot only
+ *   shares lines with itself. All slots are one mapping made (and
+ *   faulted in) by slotq_init, optionally on huge pages: MAP_HUGETLB if
+ *   the system has some reserved, else transparent huge pages
+ *   (madvise). slotq_put / slotq_get are the copying versions.
+ *
+ * Items are ints (ring_item_t); define RING_ITEM_T before the include
+ * to change that.
+ */
+
+#ifndef RING_H
+#define RING_H
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "futex_sync.h"   // cpu_relax, fevcount_t
+#include "cacheline.h"
+
+#ifndef RING_ITEM_T
+#define RING_ITEM_T int
+#endif
+typedef RING_ITEM_T ring_item_t;
+
+#define RING_SPIN 1000   // polls before sleeping (SMP only)
+
+long ring_futex(_Atomic int *addr, int op, int val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+// Sleep until *idx moves away from old (or a spurious wake-up)
+void ring_sleep(_Atomic int *sleeping, _Atomic uint64_t *idx, uint64_t old) {
+    atomic_store(sleeping, 1);
+    if (atomic_load(idx) == old)
+        ring_futex(sleeping, FUTEX_WAIT_PRIVATE, 1);
+    atomic_store_explicit(sleeping, 0, memory_order_relaxed);
+}
+
+// Called right after publishing an index (seq_cst store)
+void ring_wake(_Atomic int *sleeping) {
+    if (atomic_load(sleeping) && atomic_exchange(sleeping, 0))
+        ring_futex(sleeping, FUTEX_WAKE_PRIVATE, 1);
+}
+
+int ring_spin_count(void) {
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN : 0;
+}
+
+uint64_t ring_pow2(int capacity) {
+    uint64_t size = 1;
+    while (size < (uint64_t) capacity) size *= 2;
+    return size;
+}
+
+// Copy n items in at / out of position pos of a power-of-two buffer
+void ring_copy_in(ring_item_t *buf, uint64_t mask, uint64_t pos, const ring_item_t *x, int n) {
+    uint64_t i = pos & mask, first = mask + 1 - i;
+    if (first > (uint64_t) n) first = n;
+    memcpy(buf + i, x, first * sizeof(ring_item_t));
+    memcpy(buf, x + first, (n - first) * sizeof(ring_item_t));
+}
+
+void ring_copy_out(const ring_item_t *buf, uint64_t mask, uint64_t pos, ring_item_t *x, int n) {
+    uint64_t i = pos & mask, first = mask + 1 - i;
+    if (first > (uint64_t) n) first = n;
+    memcpy(x, buf + i, first * sizeof(ring_item_t));
+    memcpy(x + first, buf, (n - first) * sizeof(ring_item_t));
+}
+
+// ----------------------------------------------------------------
+// Single producer, single consumer
+// ----------------------------------------------------------------
+typedef struct {
+    // producer side
+    CACHE_ALIGNED _Atomic uint64_t tail;    // next slot to fill
+    uint64_t head_cache;                    // producer's copy of head
+    _Atomic int prod_sleeping;
+    // consumer side
+    CACHE_ALIGNED _Atomic uint64_t head;    // next slot to empty
+    uint64_t tail_cache;                    // consumer's copy of tail
+    _Atomic int cons_sleeping;
+    // read-only after init
+    CACHE_ALIGNED ring_item_t *buf;
+    uint64_t mask;
+    int capacity;
+    int spin;
+} spsc_ring_t;
+
+void spsc_init(spsc_ring_t *r, int capacity) {
+    uint64_t size = ring_pow2(capacity);
+    r->buf = cache_alloc(size * sizeof(ring_item_t));
+    r->mask = size - 1;
+    r->capacity = (int) size;
+    r->spin = ring_spin_count();
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->prod_sleeping, 0);
+    atomic_init(&r->cons_sleeping, 0);
+    r->head_cache = r->tail_cache = 0;
+}
+
+void spsc_destroy(spsc_ring_t *r) {
+    free(r->buf);
+}
+
+int spsc_try_put(spsc_ring_t *r, ring_item_t x) {
+    uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (t - r->head_cache > r->mask) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (t - r->head_cache > r->mask) return 0;   // really full
+    }
+    r->buf[t & r->mask] = x;
+    atomic_store(&r->tail, t + 1);
+    ring_wake(&r->cons_sleeping);
+    return 1;
+}
+
+int spsc_try_get(spsc_ring_t *r, ring_item_t *x) {
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (h == r->tail_cache) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (h == r->tail_cache) return 0;            // really empty
+    }
+    *x = r->buf[h & r->mask];
+    atomic_store(&r->head, h + 1);
+    ring_wake(&r->prod_sleeping);
+    return 1;
+}
+
+// Blocks only while the ring is full
+void spsc_put(spsc_ring_t *r, ring_item_t x) {
+    for (int polls = 0; !spsc_try_put(r, x); ++polls) {
+        if (polls < r->spin) {
+            cpu_relax();
+        } else {
+            // full means head == tail - capacity; wait for head to move
+            uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            ring_sleep(&r->prod_sleeping, &r->head, t - r->capacity);
+        }
+    }
+}
+
+// Blocks only while the ring is empty
+ring_item_t spsc_get(spsc_ring_t *r) {
+    ring_item_t x;
+    for (int polls = 0; !spsc_try_get(r, &x); ++polls) {
+        if (polls < r->spin) {
+            cpu_relax();
+        } else {
+            uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+            ring_sleep(&r->cons_sleeping, &r->tail, h);
+        }
+    }
+    return x;
+}
+
+// Put up to n items; returns how many fit (0 if full)
+int spsc_try_put_n(spsc_ring_t *r, const ring_item_t *x, int n) {
+    uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint64_t room = r->capacity - (t - r->head_cache);
+    if (room < (uint64_t) n) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        room = r->capacity - (t - r->head_cache);
+        if (room == 0) return 0;
+        if (room < (uint64_t) n) n = (int) room;
+    }
+    ring_copy_in(r->buf, r->mask, t, x, n);
+    atomic_store(&r->tail, t + n);
+    ring_wake(&r->cons_sleeping);
+    return n;
+}
+
+// Take up to max items; returns how many (0 if empty)
+int spsc_try_get_n(spsc_ring_t *r, ring_item_t *x, int max) {
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (r->tail_cache - h < (uint64_t) max) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (h == r->tail_cache) return 0;
+    }
+    int n = (r->tail_cache - h < (uint64_t) max) ? (int) (r->tail_cache - h) : max;
+    ring_copy_out(r->buf, r->mask, h, x, n);
+    atomic_store(&r->head, h + n);
+    ring_wake(&r->prod_sleeping);
+    return n;
+}
+
+void spsc_put_n(spsc_ring_t *r, const ring_item_t *x, int n) {
+    int polls = 0;
+    while (n > 0) {
+        int k = spsc_try_put_n(r, x, n);
+        if (k > 0) {
+            x += k;
+            n -= k;
+            polls = 0;
+        } else if (polls++ < r->spin) {
+            cpu_relax();
+        } else {
+            uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            ring_sleep(&r->prod_sleeping, &r->head, t - r->capacity);
+        }
+    }
+}
+
+// Blocks only while the ring is full, then puts up to n items; returns how many
+int spsc_put_some(spsc_ring_t *r, const ring_item_t *x, int n) {
+    int k;
+    for (int polls = 0; (k = spsc_try_put_n(r, x, n)) == 0; ++polls) {
+        if (polls < r->spin) {
+            cpu_relax();
+        } else {
+            uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            ring_sleep(&r->prod_sleeping, &r->head, t - r->capacity);
+        }
+    }
+    return k;
+}
+
+// Blocks only while the ring is empty, then drains up to max items
+int spsc_get_n(spsc_ring_t *r, ring_item_t *x, int max) {
+    int n;
+    for (int polls = 0; (n = spsc_try_get_n(r, x, max)) == 0; ++polls) {
+        if (polls < r->spin) {
+            cpu_relax();
+        } else {
+            uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+            ring_sleep(&r->cons_sleeping, &r->tail, h);
+        }
+    }
+    return n;
+}
+
+// ----------------------------------------------------------------
+// Multiple producers, multiple consumers
+// ----------------------------------------------------------------
+typedef struct {
+    _Atomic uint64_t seq;
+    ring_item_t data;
+} mpmc_cell_t;
+
+typedef struct {
+    CACHE_ALIGNED _Atomic uint64_t enqueue_pos;
+    CACHE_ALIGNED _Atomic uint64_t dequeue_pos;
+    CACHE_ALIGNED fevcount_t not_empty;   // consumers sleep here
+    CACHE_ALIGNED fevcount_t not_full;    // producers sleep here
+    CACHE_ALIGNED mpmc_cell_t *cells;      // read-only after init
+    uint64_t mask;
+    int capacity;
+    int spin;
+} mpmc_queue_t;
+
+void mpmc_init(mpmc_queue_t *q, int capacity) {
+    uint64_t size = ring_pow2(capacity < 2 ? 2 : capacity);
+    q->cells = cache_alloc(size * sizeof(mpmc_cell_t));
+    for (uint64_t i = 0; i < size; ++i) atomic_init(&q->cells[i].seq, i);
+    q->mask = size - 1;
+    q->capacity = (int) size;
+    q->spin = ring_spin_count();
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    fevcount_init(&q->not_empty);
+    fevcount_init(&q->not_full);
+}
+
+void mpmc_destroy(mpmc_queue_t *q) {
+    free(q->cells);
+}
+
+int mpmc_try_put(mpmc_queue_t *q, ring_item_t x) {
+    uint64_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    mpmc_cell_t *c;
+    for (;;) {
+        c = &q->cells[pos & q->mask];
+        int64_t dif = (int64_t) (atomic_load_explicit(&c->seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;                                 // the cell is a lap behind: full
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    c->data = x;
+    atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+    fevcount_signal(&q->not_empty);
+    return 1;
+}
+
+int mpmc_try_get(mpmc_queue_t *q, ring_item_t *x) {
+    uint64_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    mpmc_cell_t *c;
+    for (;;) {
+        c = &q->cells[pos & q->mask];
+        int64_t dif = (int64_t) (atomic_load_explicit(&c->seq, memory_order_acquire) - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;                                 // not filled yet: empty
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    *x = c->data;
+    atomic_store_explicit(&c->seq, pos + q->mask + 1, memory_order_release);
+    fevcount_signal(&q->not_full);
+    return 1;
+}
+
+// Conditions a sleeper re-checks after registering
+int mpmc_has_items(void *arg) {
+    mpmc_queue_t *q = arg;
+    uint64_t pos = atomic_load(&q->dequeue_pos);
+    return atomic_load(&q->cells[pos & q->mask].seq) == pos + 1;
+}
+
+int mpmc_has_room(void *arg) {
+    mpmc_queue_t *q = arg;
+    uint64_t pos = atomic_load(&q->enqueue_pos);
+    return atomic_load(&q->cells[pos & q->mask].seq) == pos;
+}
+
+void mpmc_put(mpmc_queue_t *q, ring_item_t x) {
+    for (int polls = 0; !mpmc_try_put(q, x); ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_full, mpmc_has_room, q);
+    }
+}
+
+ring_item_t mpmc_get(mpmc_queue_t *q) {
+    ring_item_t x;
+    for (int polls = 0; !mpmc_try_get(q, &x); ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_empty, mpmc_has_items, q);
+    }
+    return x;
+}
+
+// Put up to n items into consecutive cells with one CAS; returns how
+// many (0 if full)
+int mpmc_try_put_n(mpmc_queue_t *q, const ring_item_t *x, int n) {
+    uint64_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    int k;
+    for (;;) {
+        k = 0;
+        while (k < n && atomic_load_explicit(&q->cells[(pos + k) & q->mask].seq,
+                                             memory_order_acquire) == pos + k)
+            k++;
+        if (k > 0) {
+            // the cells stay ours to fill as long as enqueue_pos did not move
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + k,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if ((int64_t) (atomic_load(&q->cells[pos & q->mask].seq) - pos) < 0) {
+            return 0;                                 // full
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    for (int i = 0; i < k; ++i) {
+        mpmc_cell_t *c = &q->cells[(pos + i) & q->mask];
+        c->data = x[i];
+        atomic_store_explicit(&c->seq, pos + i + 1, memory_order_release);
+    }
+    fevcount_signal_n(&q->not_empty, k);
+    return k;
+}
+
+// Take up to max items from consecutive filled cells with one CAS
+int mpmc_try_get_n(mpmc_queue_t *q, ring_item_t *x, int max) {
+    uint64_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    int k;
+    for (;;) {
+        k = 0;
+        while (k < max && atomic_load_explicit(&q->cells[(pos + k) & q->mask].seq,
+                                               memory_order_acquire) == pos + k + 1)
+            k++;
+        if (k > 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + k,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if ((int64_t) (atomic_load(&q->cells[pos & q->mask].seq) - (pos + 1)) < 0) {
+            return 0;                                 // empty
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    for (int i = 0; i < k; ++i) {
+        mpmc_cell_t *c = &q->cells[(pos + i) & q->mask];
+        x[i] = c->data;
+        atomic_store_explicit(&c->seq, pos + i + q->mask + 1, memory_order_release);
+    }
+    fevcount_signal_n(&q->not_full, k);
+    return k;
+}
+
+void mpmc_put_n(mpmc_queue_t *q, const ring_item_t *x, int n) {
+    int polls = 0;
+    while (n > 0) {
+        int k = mpmc_try_put_n(q, x, n);
+        if (k > 0) {
+            x += k;
+            n -= k;
+            polls = 0;
+        } else if (polls++ < q->spin) {
+            cpu_relax();
+        } else {
+            fevcount_wait(&q->not_full, mpmc_has_room, q);
+        }
+    }
+}
+
+// Blocks only while the queue is full, then puts up to n items; returns how many
+int mpmc_put_some(mpmc_queue_t *q, const ring_item_t *x, int n) {
+    int k;
+    for (int polls = 0; (k = mpmc_try_put_n(q, x, n)) == 0; ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_full, mpmc_has_room, q);
+    }
+    return k;
+}
+
+// Blocks only while the queue is empty, then drains up to max items
+int mpmc_get_n(mpmc_queue_t *q, ring_item_t *x, int max) {
+    int n;
+    for (int polls = 0; (n = mpmc_try_get_n(q, x, max)) == 0; ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_empty, mpmc_has_items, q);
+    }
+    return n;
+}
+
+// ----------------------------------------------------------------
+// Slots of any size: claim / commit, acquire / release
+// ----------------------------------------------------------------
+#define SLOT_HEADER    64                    // header in front of every payload
+#define SLOT_HUGE_PAGE (2u << 20)
+
+typedef struct {
+    _Atomic uint64_t seq;   // as in mpmc_cell_t
+    size_t len;             // bytes committed
+} slot_hdr_t;
+
+typedef struct {
+    uint64_t pos;
+    void *data;             // slot_size bytes, 64-byte aligned
+    size_t len;             // after acquire: bytes the producer committed
+} slot_t;
+
+typedef struct {
+    CACHE_ALIGNED _Atomic uint64_t enqueue_pos;
+    CACHE_ALIGNED _Atomic uint64_t dequeue_pos;
+    CACHE_ALIGNED fevcount_t not_empty;
+    CACHE_ALIGNED fevcount_t not_full;
+    CACHE_ALIGNED char *mem;                // read-only after init
+    size_t stride;                          // header + payload, multiple of 64
+    size_t slot_size;
+    size_t bytes;                           // length of the mapping
+    uint64_t mask;
+    int capacity;
+    int spin;
+    int huge;                               // 0 none, 1 MAP_HUGETLB, 2 THP advised
+} slotq_t;
+
+slot_hdr_t *slotq_hdr(const slotq_t *q, uint64_t pos) {
+    return (slot_hdr_t *) (q->mem + (pos & q->mask) * q->stride);
+}
+
+void slotq_init(slotq_t *q, int capacity, size_t slot_size, int hugepages) {
+    uint64_t size = ring_pow2(capacity < 2 ? 2 : capacity);
+    q->slot_size = slot_size;
+    q->stride = SLOT_HEADER + CACHE_ROUND(slot_size);
+    q->bytes = size * q->stride;
+    q->mem = MAP_FAILED;
+    q->huge = 0;
+    if (hugepages) {
+        q->bytes = (q->bytes + SLOT_HUGE_PAGE - 1) / SLOT_HUGE_PAGE * SLOT_HUGE_PAGE;
+        q->mem = mmap(NULL, q->bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        q->huge = (q->mem != MAP_FAILED);
+    }
+    if (q->mem == MAP_FAILED) {
+        q->mem = mmap(NULL, q->bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (q->mem == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+        if (hugepages && madvise(q->mem, q->bytes, MADV_HUGEPAGE) == 0) q->huge = 2;
+        memset(q->mem, 0, q->bytes);        // fault everything in now, not on the hot path
+    }
+    q->mask = size - 1;
+    for (uint64_t i = 0; i < size; ++i) atomic_init(&slotq_hdr(q, i)->seq, i);
+    q->capacity = (int) size;
+    q->spin = ring_spin_count();
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    fevcount_init(&q->not_empty);
+    fevcount_init(&q->not_full);
+}
+
+void slotq_destroy(slotq_t *q) {
+    munmap(q->mem, q->bytes);
+}
+
+// Reserve the next free slot; 0 if all are taken
+int slotq_try_claim(slotq_t *q, slot_t *s) {
+    uint64_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        int64_t dif = (int64_t) (atomic_load_explicit(&slotq_hdr(q, pos)->seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    s->pos = pos;
+    s->data = (char *) slotq_hdr(q, pos) + SLOT_HEADER;
+    s->len = 0;
+    return 1;
+}
+
+// Publish a claimed slot holding len bytes
+void slotq_commit(slotq_t *q, const slot_t *s, size_t len) {
+    slot_hdr_t *h = slotq_hdr(q, s->pos);
+    h->len = len;
+    atomic_store_explicit(&h->seq, s->pos + 1, memory_order_release);
+    fevcount_signal(&q->not_empty);
+}
+
+// Take the oldest committed slot; 0 if there is none
+int slotq_try_acquire(slotq_t *q, slot_t *s) {
+    uint64_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        int64_t dif = (int64_t) (atomic_load_explicit(&slotq_hdr(q, pos)->seq, memory_order_acquire) - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    slot_hdr_t *h = slotq_hdr(q, pos);
+    s->pos = pos;
+    s->data = (char *) h + SLOT_HEADER;
+    s->len = h->len;
+    return 1;
+}
+
+// Hand an acquired slot back to the producers
+void slotq_release(slotq_t *q, const slot_t *s) {
+    atomic_store_explicit(&slotq_hdr(q, s->pos)->seq, s->pos + q->mask + 1, memory_order_release);
+    fevcount_signal(&q->not_full);
+}
+
+int slotq_has_items(void *arg) {
+    slotq_t *q = arg;
+    uint64_t pos = atomic_load(&q->dequeue_pos);
+    return atomic_load(&slotq_hdr(q, pos)->seq) == pos + 1;
+}
+
+int slotq_has_room(void *arg) {
+    slotq_t *q = arg;
+    uint64_t pos = atomic_load(&q->enqueue_pos);
+    return atomic_load(&slotq_hdr(q, pos)->seq) == pos;
+}
+
+void slotq_claim(slotq_t *q, slot_t *s) {
+    for (int polls = 0; !slotq_try_claim(q, s); ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_full, slotq_has_room, q);
+    }
+}
+
+void slotq_acquire(slotq_t *q, slot_t *s) {
+    for (int polls = 0; !slotq_try_acquire(q, s); ++polls) {
+        if (polls < q->spin) cpu_relax();
+        else fevcount_wait(&q->not_empty, slotq_has_items, q);
+    }
+}
+
+// Copying versions: len <= slot_size
+void slotq_put(slotq_t *q, const void *data, size_t len) {
+    slot_t s;
+    slotq_claim(q, &s);
+    memcpy(s.data, data, len);
+    slotq_commit(q, &s, len);
+}
+
+size_t slotq_get(slotq_t *q, void *data) {
+    slot_t s;
+    slotq_acquire(q, &s);
+    memcpy(data, s.data, s.len);
+    slotq_release(q, &s);
+    return s.len;
+}
+
+#endif
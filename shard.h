@@ -0,0 +1,241 @@
+/*
+ * shard.h
+ *
+ * Sharded queues for the producer-consumer programs: every consumer owns
+ * a bounded deque of its own instead of all of them sharing one buffer,
+ * so adding consumers adds queues rather than contention on one lock.
+ *
+ * Header-only: include it from exactly one .c file per program, e.g.
+ *   #include "shard.h"
+ *   gcc -O2 prog.c -o prog -pthread
+ *
+ * shardset_t: n shards (shard_t), one per consumer. A producer picks the
+ *   shard for each put: round-robin with a cursor of its own
+ *   (shards_pick_rr, no shared counter) or by hashing a key
+ *   (shards_pick_key), so every item with the same key lands in the
+ *   same shard. A put appends a run at the shard's tail and blocks while
+ *   that shard is full.
+ *
+ *   Consumer i takes from the head of shard i (oldest first). When it is
+ *   empty and stealing is on, it takes up to half of another shard's
+ *   items from that shard's tail, the end its owner gets to last, and
+ *   only sleeps if every shard is empty. Without stealing a consumer
+ *   only ever sees its own shard, so items with the same key are
+ *   consumed one at a time and in the order they were put (per-key
+ *   ordering); with stealing they may not be.
+ *
+ *   Each shard has its own fmutex_t (futex_sync.h) on its own cache
+ *   line. It is contended only by the producers that picked this shard
+ *   and, now and then, a thief, and a run of items costs one lock.
+ *   Sleepers use fevcount_t: consumers on the set's idle counter (with
+ *   stealing, where any put is work for anyone) or on their shard's
+ *   not_empty (without), producers on the shard's not_full.
+ *
+ *   shards_close() says no more puts are coming. Consumers then drain
+ *   what is left (their own shard, or everything with stealing) and
+ *   shards_get_n returns 0 once there is nothing left for them.
+ *
+ * Items are ints (shard_item_t); define SHARD_ITEM_T before the include
+ * to change that.
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "futex_sync.h"   // fmutex_t, fevcount_t
+#include "cacheline.h"
+
+#ifndef SHARD_ITEM_T
+#define SHARD_ITEM_T int
+#endif
+typedef SHARD_ITEM_T shard_item_t;
+
+typedef struct {
+    // written under lock
+    CACHE_ALIGNED fmutex_t lock;
+    _Atomic uint64_t head;     // next item to take (owner)
+    _Atomic uint64_t tail;     // next free slot (producers); thieves take below it
+    // sleepers
+    CACHE_ALIGNED fevcount_t not_empty;   // the owner, without stealing
+    fevcount_t not_full;                  // producers
+    // read-only after init
+    CACHE_ALIGNED shard_item_t *buf;
+    int capacity;
+    _Atomic int *closed;       // the set's flag
+} shard_t;
+
+typedef struct {
+    shard_t *shards;           // read-only after init
+    int n;
+    int steal;                 // idle consumers take from other shards
+    CACHE_ALIGNED fevcount_t idle;        // consumers with nothing to do, with stealing
+    _Atomic int closed;
+} shardset_t;
+
+// Shard the calling thread's last shards_get_n took its items from
+_Thread_local int shards_from;
+
+void shards_init(shardset_t *set, int n, int capacity, int steal) {
+    set->shards = cache_alloc(sizeof(shard_t) * n);
+    for (int i = 0; i < n; ++i) {
+        shard_t *s = &set->shards[i];
+        fmutex_init(&s->lock);
+        atomic_init(&s->head, 0);
+        atomic_init(&s->tail, 0);
+        fevcount_init(&s->not_empty);
+        fevcount_init(&s->not_full);
+        s->buf = cache_alloc(sizeof(shard_item_t) * capacity);
+        s->capacity = capacity;
+        s->closed = &set->closed;
+    }
+    set->n = n;
+    set->steal = steal;
+    fevcount_init(&set->idle);
+    atomic_init(&set->closed, 0);
+}
+
+void shards_destroy(shardset_t *set) {
+    for (int i = 0; i < set->n; ++i) free(set->shards[i].buf);
+    free(set->shards);
+}
+
+// Shard for the next put of a producer that keeps *cursor (start it anywhere)
+int shards_pick_rr(shardset_t *set, unsigned *cursor) {
+    return (int) ((*cursor)++ % (unsigned) set->n);
+}
+
+// Shard for a key: the same key always gives the same shard
+int shards_pick_key(shardset_t *set, uint32_t key) {
+    return (int) (((uint64_t) (key * 2654435761u) * (uint64_t) set->n) >> 32);
+}
+
+// Outside the lock: a snapshot, exact enough for "empty?" / "full?"
+int shard_size(shard_t *s) {
+    return (int) (atomic_load(&s->tail) - atomic_load(&s->head));
+}
+
+// Conditions a sleeper re-checks after registering
+int shard_has_room(void *arg) {
+    shard_t *s = arg;
+    return shard_size(s) < s->capacity;
+}
+
+int shard_has_items_or_closed(void *arg) {
+    shard_t *s = arg;
+    return shard_size(s) > 0 || atomic_load(s->closed);
+}
+
+int shards_any_items(void *arg) {
+    shardset_t *set = arg;
+    if (atomic_load(&set->closed)) return 1;
+    for (int i = 0; i < set->n; ++i)
+        if (shard_size(&set->shards[i]) > 0) return 1;
+    return 0;
+}
+
+// Copy a run into / out of the shard at position pos, wrapping around the end
+void shard_copy_in(shard_t *s, uint64_t pos, const shard_item_t *x, int n) {
+    int at = (int) (pos % (uint64_t) s->capacity);
+    int first = s->capacity - at < n ? s->capacity - at : n;
+    memcpy(s->buf + at, x, first * sizeof(shard_item_t));
+    memcpy(s->buf, x + first, (n - first) * sizeof(shard_item_t));
+}
+
+void shard_copy_out(shard_t *s, uint64_t pos, shard_item_t *x, int n) {
+    int at = (int) (pos % (uint64_t) s->capacity);
+    int first = s->capacity - at < n ? s->capacity - at : n;
+    memcpy(x, s->buf + at, first * sizeof(shard_item_t));
+    memcpy(x + first, s->buf, (n - first) * sizeof(shard_item_t));
+}
+
+// Put up to n items at the tail of shard i if there is room; returns how many
+int shards_try_put_n(shardset_t *set, int i, const shard_item_t *x, int n) {
+    shard_t *s = &set->shards[i];
+    fmutex_lock(&s->lock);
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    int room = s->capacity - (int) (tail - atomic_load_explicit(&s->head, memory_order_relaxed));
+    if (n > room) n = room;
+    shard_copy_in(s, tail, x, n);
+    atomic_store_explicit(&s->tail, tail + n, memory_order_relaxed);
+    fmutex_unlock(&s->lock);
+    if (n > 0) fevcount_signal_n(set->steal ? &set->idle : &s->not_empty, n);
+    return n;
+}
+
+// Put all n items into shard i, waiting for room as needed
+void shards_put_n(shardset_t *set, int i, const shard_item_t *x, int n) {
+    shard_t *s = &set->shards[i];
+    while (n > 0) {
+        int k = shards_try_put_n(set, i, x, n);
+        if (k == 0) fevcount_wait(&s->not_full, shard_has_room, s);
+        x += k;
+        n -= k;
+    }
+}
+
+void shards_put(shardset_t *set, int i, shard_item_t x) {
+    shards_put_n(set, i, &x, 1);
+}
+
+// Take up to max items from the head of shard i (its owner); returns how many
+int shards_try_take_n(shardset_t *set, int i, shard_item_t *x, int max) {
+    shard_t *s = &set->shards[i];
+    if (shard_size(s) == 0) return 0;           // don't lock an empty shard
+    fmutex_lock(&s->lock);
+    uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    int n = (int) (atomic_load_explicit(&s->tail, memory_order_relaxed) - head);
+    if (n > max) n = max;
+    shard_copy_out(s, head, x, n);
+    atomic_store_explicit(&s->head, head + n, memory_order_relaxed);
+    fmutex_unlock(&s->lock);
+    if (n > 0) fevcount_signal_n(&s->not_full, n);
+    return n;
+}
+
+// Take up to half the items of shard i (at most max) from its tail
+int shards_try_steal_n(shardset_t *set, int i, shard_item_t *x, int max) {
+    shard_t *s = &set->shards[i];
+    if (shard_size(s) == 0) return 0;
+    fmutex_lock(&s->lock);
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    int size = (int) (tail - atomic_load_explicit(&s->head, memory_order_relaxed));
+    int n = (size + 1) / 2;
+    if (n > max) n = max;
+    shard_copy_out(s, tail - n, x, n);
+    atomic_store_explicit(&s->tail, tail - n, memory_order_relaxed);
+    fmutex_unlock(&s->lock);
+    if (n > 0) fevcount_signal_n(&s->not_full, n);
+    return n;
+}
+
+// Consumer self: wait for at least one item, then take up to max, from
+// its own shard or (with stealing) another one. Returns 0 once the set
+// is closed and there is nothing left for self.
+int shards_get_n(shardset_t *set, int self, shard_item_t *x, int max) {
+    for (;;) {
+        // every put happens before the close, so after seeing closed an
+        // empty scan is final
+        int closed = atomic_load(&set->closed);
+        int n = shards_try_take_n(set, self, x, max);
+        shards_from = self;
+        for (int k = 1; n == 0 && set->steal && k < set->n; ++k)
+            n = shards_try_steal_n(set, shards_from = (self + k) % set->n, x, max);
+        if (n > 0) return n;
+        if (closed) return 0;
+        if (set->steal) fevcount_wait(&set->idle, shards_any_items, set);
+        else fevcount_wait(&set->shards[self].not_empty, shard_has_items_or_closed, &set->shards[self]);
+    }
+}
+
+// No more puts: wake every consumer so it can drain and finish
+void shards_close(shardset_t *set) {
+    atomic_store(&set->closed, 1);
+    fevcount_signal_n(&set->idle, INT_MAX);
+    for (int i = 0; i < set->n; ++i) fevcount_signal_n(&set->shards[i].not_empty, INT_MAX);
+}
+
+#endif
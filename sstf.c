@@ -7,7 +7,7 @@
  *   gcc -o sstf sstf.c
  *
  * Run:
- *   ./sstf
+ *   ./sstf [max_gap [max_count]]
  *
  * Input:
  *   - number of requests (n)
@@ -19,6 +19,10 @@
  *   - distance moved for each step
  *   - total seek distance
  *   - average seek distance
+ *   - with max_gap given: the same run after merging requests that are
+ *     at most max_gap cylinders apart (at most max_count per dispatch,
+ *     default 8), and how many dispatches and cylinders that saved. The
+ *     head enters a merged dispatch at whichever end is nearer.
  *
  * Notes:
  *   - Assumes integer cylinder numbers.
@@ -51,7 +55,116 @@ int find_nearest(int requests[], int served[], int n, int head) {
     return best_idx;
 }
 
-int main(void) {
+/* qsort() helper: orders request indices by sort_key[] */
+static const int *sort_key;
+static int compare_idx(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    if (sort_key[x] != sort_key[y]) return sort_key[x] < sort_key[y] ? -1 : 1;
+    return x - y;
+}
+
+/*
+ * Merge stage, the same as merge_requests() in disk_sched.h (without
+ * sectors): walking the requests in cylinder order, a request is
+ * back-merged into the current dispatch if it is at most max_gap
+ * cylinders past its end and the dispatch holds fewer than max_count
+ * requests, like the block layer's front/back merges over a batch.
+ */
+typedef struct {
+    int n;          // number of merged dispatches
+    int *start;     // first cylinder covered
+    int *end;       // last cylinder covered
+    int *first;     // members of dispatch i are member[first[i] .. first[i+1]-1]
+    int *member;    // original request indices
+} merge_t;
+
+merge_t merge_requests(const int requests[], int n, int max_gap, int max_count) {
+    merge_t m;
+    m.n = 0;
+    m.start = malloc(n * sizeof(int));
+    m.end = malloc(n * sizeof(int));
+    m.first = malloc((n + 1) * sizeof(int));
+    m.member = malloc(n * sizeof(int));
+
+    for (int i = 0; i < n; ++i) m.member[i] = i;
+    sort_key = requests;
+    qsort(m.member, n, sizeof(int), compare_idx);
+
+    for (int k = 0; k < n; ++k) {
+        int i = m.member[k];
+        int cur = m.n - 1;
+        if (cur >= 0 && requests[i] - m.end[cur] <= max_gap && k - m.first[cur] < max_count) {
+            m.end[cur] = requests[i];     // back merge
+        } else {
+            m.start[m.n] = m.end[m.n] = requests[i];
+            m.first[m.n] = k;
+            m.n++;
+        }
+    }
+    m.first[m.n] = n;
+    return m;
+}
+
+void merge_free(merge_t *m) {
+    free(m->start);
+    free(m->end);
+    free(m->first);
+    free(m->member);
+}
+
+/* Cylinders from head to the nearest end of a dispatch (0 inside it) */
+int span_distance(const merge_t *m, int d, int head) {
+    if (head < m->start[d]) return m->start[d] - head;
+    if (head > m->end[d]) return head - m->end[d];
+    return 0;
+}
+
+/* SSTF over merged dispatches; prints the steps and returns total seek */
+long sstf_merged(int requests[], int n, int head, int max_gap, int max_count) {
+    merge_t m = merge_requests(requests, n, max_gap, max_count);
+    int *served = calloc(m.n, sizeof(int));
+
+    printf("\nWith merging (gap <= %d, <= %d per dispatch): %d requests -> %d dispatches\n",
+           max_gap, max_count, n, m.n);
+    long total_seek = 0;
+    int cur = head;
+    for (int step = 1; step <= m.n; ++step) {
+        // nearest dispatch by distance to its span; ties to the lower one
+        int idx = -1;
+        for (int d = 0; d < m.n; ++d) {
+            if (served[d]) continue;
+            if (idx == -1 || span_distance(&m, d, cur) < span_distance(&m, idx, cur)) idx = d;
+        }
+        // enter at the nearer end and read through to the other
+        int from = m.start[idx], to = m.end[idx];
+        if (cur - from > to - cur) {
+            from = m.end[idx];
+            to = m.start[idx];
+        }
+        int move = abs(from - cur) + abs(to - from);
+        printf("Step %2d: Move from %d -> %d", step, cur, from);
+        if (to != from) printf("-%d", to);
+        printf("  |  Distance = %d  |  requests", move);
+        for (int j = m.first[idx]; j < m.first[idx + 1]; ++j) printf(" %d", m.member[j] + 1);
+        printf("\n");
+        total_seek += move;
+        cur = to;
+        served[idx] = 1;
+    }
+
+    merge_free(&m);
+    free(served);
+    return total_seek;
+}
+
+int main(int argc, char *argv[]) {
+    int max_gap = (argc > 1) ? atoi(argv[1]) : -1;   // -1: no merge stage
+    int max_count = (argc > 2) ? atoi(argv[2]) : 8;
+    if (argc > 1 && (max_gap < 0 || max_count <= 0)) {
+        fprintf(stderr, "Usage: %s [max_gap [max_count]]\n", argv[0]);
+        return 1;
+    }
+
     int n;
     printf("Enter number of requests: ");
     if (scanf("%d", &n) != 1 || n <= 0) {
@@ -119,6 +232,12 @@ int main(void) {
     printf("\nTotal seek distance = %ld\n", total_seek);
     printf("Average seek distance = %.2f\n", avg_seek);
 
+    if (max_gap >= 0) {
+        long merged_seek = sstf_merged(requests, n, head, max_gap, max_count);
+        printf("\nTotal seek distance with merging = %ld (saved %ld)\n",
+               merged_seek, total_seek - merged_seek);
+    }
+
     // cleanup
     free(requests);
     free(served);